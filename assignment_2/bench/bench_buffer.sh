@@ -0,0 +1,50 @@
+#!/usr/bin/env bash
+# 큰 파일 하나를 버퍼 크기별로 복사해 처리량 비교 (--direct 경로)
+#
+# 사용법: ./bench/bench_buffer.sh [SIZE_MB] [DIR]
+#   SIZE_MB  테스트 파일 크기 (기본: 512)
+#   DIR      파일을 만들 디렉터리 (기본: mktemp -d, 재려는 디스크 위를 권장)
+#
+# --direct 는 페이지 캐시를 거치지 않으므로 버퍼 크기가 곧 디스크 요청 크기입니다.
+# 비교용으로 자동 크기(--direct 만)와 기본 경로(copy_file_range 등)도 잽니다.
+# root 면 매 실행 전에 페이지 캐시를 비웁니다.
+set -euo pipefail
+
+SCRIPT_DIR=$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)
+PROG="$SCRIPT_DIR/../xcopy"
+SIZE_MB=${1:-512}
+WORK_DIR=$(mktemp -d ${2:+-p "$2"})
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+if [ ! -x "$PROG" ]; then
+    echo "build xcopy first: $PROG" >&2
+    exit 1
+fi
+
+echo "Generating ${SIZE_MB}MiB file in $WORK_DIR"
+head -c $((SIZE_MB * 1024 * 1024)) /dev/urandom > "$WORK_DIR/src.bin"
+sync
+
+run_case() {
+    local label=$1; shift
+    rm -f "$WORK_DIR/dst.bin"
+    sync
+    if [ "$(id -u)" -eq 0 ]; then
+        echo 3 > /proc/sys/vm/drop_caches
+    fi
+    local start end
+    start=$(date +%s.%N)
+    "$PROG" --reflink=never "$@" "$WORK_DIR/src.bin" "$WORK_DIR/dst.bin"
+    sync
+    end=$(date +%s.%N)
+    awk -v l="$label" -v s="$start" -v e="$end" -v m="$SIZE_MB" \
+        'BEGIN { t = e - s; printf "%-14s %8.3f s %10.1f MiB/s\n", l, t, m / t }'
+}
+
+for size in 64K 128K 256K 512K 1M 4M 16M; do
+    run_case "direct $size" --direct --buffer-size="$size"
+done
+run_case "direct auto" --direct
+run_case "default"
+
+cmp -s "$WORK_DIR/src.bin" "$WORK_DIR/dst.bin" && echo "[PASS] copy matches source"
@@ -0,0 +1,179 @@
+#!/usr/bin/env bash
+# 합성 트리 x 복사 모드 x 캐시 상태(cold/warm) 전체 벤치마크
+#
+# 사용법: ./bench/bench_suite.sh [-j JOBS] [-s SCALE] [-r RUNS] [-t TREES] [-w DIR] [-o FILE]
+#         ./bench/bench_suite.sh -c OLD.tsv NEW.tsv
+#   -j JOBS   병렬 모드 작업자 수 (기본: nproc)
+#   -s SCALE  gen_tree.sh 크기 배율 (기본: 1)
+#   -r RUNS   조합마다 잴 횟수, 가장 빠른 값을 기록 (기본: 3)
+#   -t TREES  쉼표로 구분한 트리 목록 (기본: tiny,huge,deep,wide,sparse,hardlink)
+#   -w DIR    트리를 만들어 둘 디렉터리. 지정하면 다음 실행에서 재사용 (기본: mktemp -d)
+#   -o FILE   결과를 FILE 에도 저장
+#   -c        두 결과 파일을 tree/mode/cache 기준으로 맞춰 seconds 변화율 출력
+#
+# 결과는 '#' 메타데이터 줄 다음에 탭으로 구분한 고정 순서의 행입니다.
+#   tree  mode  cache  files  bytes  seconds  files_per_s  mib_per_s
+# 행 순서와 숫자 형식이 고정이라 커밋마다 저장해 두고 diff 나 -c 로 비교할 수 있습니다.
+# cold 는 매 실행 전에 페이지 캐시를 비우므로 root 가 필요하고, 못 비우면 값이 NA 입니다.
+# warm 은 한 번 복사해 캐시를 채운 뒤 잽니다. 시간에는 마지막 sync 까지 포함합니다.
+set -euo pipefail
+
+SCRIPT_DIR=$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)
+PROG="$SCRIPT_DIR/../xcopy"
+GEN="$SCRIPT_DIR/gen_tree.sh"
+JOBS=$(nproc)
+SCALE=1
+RUNS=3
+TREES=tiny,huge,deep,wide,sparse,hardlink
+TREE_DIR=
+OUT=
+COMPARE=0
+
+while getopts "j:s:r:t:w:o:c" opt; do
+    case "$opt" in
+        j) JOBS=$OPTARG ;;
+        s) SCALE=$OPTARG ;;
+        r) RUNS=$OPTARG ;;
+        t) TREES=$OPTARG ;;
+        w) TREE_DIR=$OPTARG ;;
+        o) OUT=$OPTARG ;;
+        c) COMPARE=1 ;;
+        *) sed -n '2,14p' "$0" >&2; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+# -c: 두 결과의 같은 행끼리 seconds 를 비교 (+ 는 느려짐)
+if [ "$COMPARE" -eq 1 ]; then
+    if [ $# -ne 2 ]; then
+        echo "usage: $0 -c OLD.tsv NEW.tsv" >&2
+        exit 2
+    fi
+    awk -F '\t' '
+        /^#/ || $1 == "tree" { next }
+        FNR == NR { old[$1 FS $2 FS $3] = $6; next }
+        {
+            k = $1 FS $2 FS $3
+            if (!(k in old) || old[k] == "NA" || $6 == "NA" || old[k] == 0)
+                d = "NA"
+            else
+                d = sprintf("%+.1f%%", ($6 - old[k]) * 100 / old[k])
+            printf "%-9s %-9s %-5s %10s %10s %8s\n", $1, $2, $3, (k in old) ? old[k] : "-", $6, d
+        }' "$1" "$2"
+    exit 0
+fi
+
+if [ ! -x "$PROG" ]; then
+    echo "build xcopy first: $PROG" >&2
+    exit 1
+fi
+
+WORK_DIR=$(mktemp -d ${TREE_DIR:+-p "$TREE_DIR"})
+trap 'rm -rf "$WORK_DIR"' EXIT
+TREE_DIR=${TREE_DIR:-$WORK_DIR}
+
+can_drop=0
+if [ "$(id -u)" -eq 0 ] && (sync && echo 3 > /proc/sys/vm/drop_caches) 2> /dev/null; then
+    can_drop=1
+fi
+
+# 트리별 모드 목록: 공통 3 개 + 트리 특성에 맞는 모드
+modes_for() {
+    echo "serial parallel verify"
+    case "$1" in
+        huge) echo "direct" ;;
+        sparse) echo "no-sparse" ;;
+        hardlink) echo "links" ;;
+    esac
+}
+
+mode_args() {
+    case "$1" in
+        serial) echo "-r" ;;
+        parallel) echo "-r -j $JOBS" ;;
+        verify) echo "-r -j $JOBS --verify" ;;
+        direct) echo "-r --direct" ;;
+        no-sparse) echo "-r --sparse=never" ;;
+        links) echo "-r -j $JOBS --preserve=links" ;;
+    esac
+}
+
+# tree_size DIR: 일반 파일 수와 크기 합 (하드 링크는 링크마다 셈)
+tree_size() {
+    find "$1" -type f -printf '%s\n' | awk '{ n++; b += $1 } END { printf "%d\t%.0f\n", n, b }'
+}
+
+# time_copy SRC ARGS COLD: 한 번 복사하고 걸린 초를 출력
+time_copy() {
+    local src=$1 args=$2 cold=$3
+    rm -rf "$WORK_DIR/dst"
+    sync
+    if [ "$cold" -eq 1 ]; then
+        echo 3 > /proc/sys/vm/drop_caches
+    fi
+    local start end
+    start=$(date +%s.%N)
+    # shellcheck disable=SC2086
+    "$PROG" $args "$src" "$WORK_DIR/dst"
+    sync
+    end=$(date +%s.%N)
+    awk -v s="$start" -v e="$end" 'BEGIN { printf "%.6f\n", e - s }'
+}
+
+run_row() {
+    local tree=$1 mode=$2 cache=$3 src=$4 files=$5 bytes=$6
+    local args best= t cold=0
+    args=$(mode_args "$mode")
+    if [ "$cache" = cold ]; then
+        if [ "$can_drop" -eq 0 ]; then
+            printf '%s\t%s\t%s\t%s\t%s\tNA\tNA\tNA\n' "$tree" "$mode" cold "$files" "$bytes"
+            return
+        fi
+        cold=1
+    else
+        time_copy "$src" "$args" 0 > /dev/null   # 캐시 채우기
+    fi
+    for _ in $(seq 1 "$RUNS"); do
+        t=$(time_copy "$src" "$args" "$cold")
+        best=$(awk -v a="$t" -v b="$best" 'BEGIN { print (b == "" || a < b) ? a : b }')
+    done
+    # 결과 확인: 파일 수와 크기 합이 같아야 함
+    if [ "$(tree_size "$WORK_DIR/dst")" != "$files	$bytes" ]; then
+        echo "copy mismatch: $tree $mode $cache" >&2
+        exit 1
+    fi
+    awk -v r="$tree	$mode	$cache	$files	$bytes" -v t="$best" -v n="$files" -v b="$bytes" \
+        'BEGIN { printf "%s\t%.3f\t%.1f\t%.1f\n", r, t, n / t, b / 1048576 / t }'
+}
+
+run_suite() {
+    echo "# xcopy-bench 1"
+    echo "# commit $(git -C "$SCRIPT_DIR" rev-parse --short HEAD 2> /dev/null || echo unknown)"
+    echo "# kernel $(uname -r)"
+    echo "# fs $(stat -f -c %T "$WORK_DIR")"
+    echo "# jobs $JOBS scale $SCALE runs $RUNS"
+    printf 'tree\tmode\tcache\tfiles\tbytes\tseconds\tfiles_per_s\tmib_per_s\n'
+
+    local tree src size files bytes mode cache
+    for tree in ${TREES//,/ }; do
+        src="$TREE_DIR/$tree-s$SCALE"
+        if [ ! -d "$src" ]; then
+            echo "Generating $tree tree in $src" >&2
+            "$GEN" "$tree" "$src" "$SCALE"
+        fi
+        size=$(tree_size "$src")
+        files=${size%	*}
+        bytes=${size#*	}
+        for mode in $(modes_for "$tree"); do
+            for cache in cold warm; do
+                run_row "$tree" "$mode" "$cache" "$src" "$files" "$bytes"
+            done
+        done
+    done
+}
+
+if [ -n "$OUT" ]; then
+    run_suite | tee "$OUT"
+else
+    run_suite
+fi
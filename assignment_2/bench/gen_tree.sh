@@ -0,0 +1,97 @@
+#!/usr/bin/env bash
+# 벤치마크용 합성 트리 생성기. 같은 인자면 항상 같은 트리(이름, 크기, 내용)를 만듭니다.
+#
+# 사용법: ./bench/gen_tree.sh KIND DIR [SCALE]
+#   KIND   tiny | huge | deep | wide | sparse | hardlink
+#   DIR    만들 디렉터리 (없어야 함)
+#   SCALE  크기 배율, 정수 (기본: 1)
+#
+#   tiny      200 디렉터리 x 100 개, 0~1023 바이트 파일     (20000 x SCALE 파일)
+#   huge      128MiB 파일 3 개                             (크기 x SCALE)
+#   deep      깊이 200 의 디렉터리 사슬, 단계마다 작은 파일 (깊이 x SCALE)
+#   wide      한 디렉터리에 20000 개의 작은 파일            (20000 x SCALE 파일)
+#   sparse    겉보기 256MiB, 실제 데이터 1MiB 씩인 파일 8 개 (개수 x SCALE)
+#   hardlink  1MiB 파일 200 개, 각각 링크 10 개            (파일 수 x SCALE)
+set -euo pipefail
+
+KIND=${1:?KIND required}
+DIR=${2:?DIR required}
+SCALE=${3:-1}
+
+if [ -e "$DIR" ]; then
+    echo "$DIR already exists" >&2
+    exit 1
+fi
+mkdir -p "$DIR"
+
+# 고정 시드 LCG 로 만든 1MiB 블록. 큰 파일은 이 블록을 이어 붙입니다.
+# (0 이 아닌 내용이라 --sparse=always 의 0 블록 검출에 걸리지 않음)
+SEED_BLOCK="$DIR/.seed"
+awk 'BEGIN { x = 12345; for (i = 0; i < 65536; i++) {
+         x = (x * 1103515245 + 12345) % 2147483648; printf "%015x\n", x } }' \
+    > "$SEED_BLOCK"
+
+# make_file PATH SIZE: 시드 블록에서 SIZE 바이트를 잘라 씀
+make_file() {
+    local path=$1 size=$2
+    if [ "$size" -le 1048576 ]; then
+        head -c "$size" "$SEED_BLOCK" > "$path"
+    else
+        local n=$(( (size + 1048575) / 1048576 ))
+        for _ in $(seq 1 "$n"); do cat "$SEED_BLOCK"; done | head -c "$size" > "$path"
+    fi
+}
+
+case "$KIND" in
+    tiny)
+        for d in $(seq 1 $((200 * SCALE))); do
+            mkdir -p "$DIR/d$((d % 20))/d$d"
+            for f in $(seq 1 100); do
+                make_file "$DIR/d$((d % 20))/d$d/f$f" $(( (d * 131 + f * 17) % 1024 ))
+            done
+        done
+        ;;
+    huge)
+        for f in 1 2 3; do
+            make_file "$DIR/huge$f.bin" $((128 * 1048576 * SCALE))
+        done
+        ;;
+    deep)
+        path="$DIR"
+        for level in $(seq 1 $((200 * SCALE))); do
+            path="$path/l$level"
+            mkdir "$path"
+            make_file "$path/f" $((level * 7 % 4096))
+        done
+        ;;
+    wide)
+        for f in $(seq 1 $((20000 * SCALE))); do
+            make_file "$DIR/f$f" $((f * 13 % 2048))
+        done
+        ;;
+    sparse)
+        for f in $(seq 1 $((8 * SCALE))); do
+            truncate -s 256M "$DIR/sparse$f.bin"
+            # 앞, 가운데, 끝 근처에 데이터 구간
+            for off in 0 128 255; do
+                head -c 349525 "$SEED_BLOCK" |
+                    dd of="$DIR/sparse$f.bin" bs=1M seek="$off" conv=notrunc status=none
+            done
+        done
+        ;;
+    hardlink)
+        mkdir -p "$DIR/objects" "$DIR/links"
+        for f in $(seq 1 $((200 * SCALE))); do
+            make_file "$DIR/objects/o$f" 1048576
+            for l in $(seq 1 10); do
+                mkdir -p "$DIR/links/l$l"
+                ln "$DIR/objects/o$f" "$DIR/links/l$l/o$f"
+            done
+        done
+        ;;
+    *)
+        echo "unknown KIND: $KIND" >&2
+        exit 2
+        ;;
+esac
+rm -f "$SEED_BLOCK"
@@ -0,0 +1,243 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+SCRIPT_DIR=$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)
+PROG="$SCRIPT_DIR/../xcopy"
+TEST_DIR=$(mktemp -d)
+cd "$TEST_DIR"
+
+echo "Running xcopy smoke tests in $TEST_DIR"
+
+mkdir -p src/sub/deep
+echo "hello" > src/a.txt
+echo "world" > src/sub/b.txt
+head -c 300000 /dev/urandom > src/sub/deep/big.bin
+
+# Test 1: 단일 파일 복사
+$PROG src/a.txt one.txt
+if cmp -s src/a.txt one.txt; then
+    echo "[PASS] single file copy"
+else
+    echo "[FAIL] single file copy"
+    exit 1
+fi
+
+# Test 2: -r 직렬 복사
+$PROG -r src out_serial
+if diff -r src out_serial > /dev/null; then
+    echo "[PASS] recursive copy"
+else
+    echo "[FAIL] recursive copy"
+    diff -r src out_serial || true
+    exit 1
+fi
+
+# Test 3: -r -j 4 병렬 복사
+$PROG -r -j 4 src out_parallel
+if diff -r src out_parallel > /dev/null; then
+    echo "[PASS] parallel recursive copy (-j 4)"
+else
+    echo "[FAIL] parallel recursive copy (-j 4)"
+    diff -r src out_parallel || true
+    exit 1
+fi
+
+# Test 4: 잘못된 옵션은 종료 코드 2
+rc=0
+$PROG -j 0 src bad 2> /dev/null || rc=$?
+if [ "$rc" -eq 2 ]; then
+    echo "[PASS] invalid -j exits with 2"
+else
+    echo "[FAIL] invalid -j exit code: $rc"
+    exit 1
+fi
+
+# Test 5: --reflink=never 는 항상 데이터 복사
+$PROG --reflink=never src/sub/deep/big.bin never.bin
+if cmp -s src/sub/deep/big.bin never.bin; then
+    echo "[PASS] --reflink=never copies data"
+else
+    echo "[FAIL] --reflink=never"
+    exit 1
+fi
+
+# Test 6: --reflink=always 는 CoW 파일 시스템(btrfs, XFS)에서만 성공해야 함
+rc=0
+$PROG --reflink=always src/sub/deep/big.bin always.bin 2> always.err || rc=$?
+if [ "$rc" -eq 0 ] && cmp -s src/sub/deep/big.bin always.bin; then
+    echo "[PASS] --reflink=always cloned the file"
+elif [ "$rc" -eq 1 ] && grep -q "reflink not supported" always.err; then
+    echo "[SKIP] --reflink=always: $(stat -f -c %T .) does not support reflink"
+else
+    echo "[FAIL] --reflink=always (rc=$rc)"
+    cat always.err
+    exit 1
+fi
+
+# Test 7: --update 는 바뀌지 않은 파일을 건너뛰고 요약을 출력
+$PROG -r --update src out_serial > update.out
+if grep -q "copied: 0, skipped: 3, failed: 0" update.out; then
+    echo "[PASS] --update skips unchanged files"
+else
+    echo "[FAIL] --update summary"
+    cat update.out
+    exit 1
+fi
+echo "hellO" > src/a.txt
+$PROG -r --update --checksum src out_serial > update.out
+if grep -q "copied: 1, skipped: 2, failed: 0" update.out && cmp -s src/a.txt out_serial/a.txt; then
+    echo "[PASS] --update --checksum copies same-size changed file"
+else
+    echo "[FAIL] --update --checksum"
+    cat update.out
+    exit 1
+fi
+
+# Test 8: 희소 파일은 구멍을 유지한 채 복사
+truncate -s 64M sparse.img
+printf 'tail' >> sparse.img
+$PROG sparse.img sparse_copy.img
+if cmp -s sparse.img sparse_copy.img && [ "$(du -k sparse_copy.img | cut -f1)" -lt 1024 ]; then
+    echo "[PASS] sparse file keeps holes"
+else
+    echo "[FAIL] sparse file copy ($(du -k sparse_copy.img | cut -f1) KiB allocated)"
+    exit 1
+fi
+
+# Test 9: -p 는 파일과 하위 디렉터리의 권한/시간을 복사하면서 함께 보존
+mkdir -p psrc/ro
+echo data > psrc/ro/f.txt
+chmod 600 psrc/ro/f.txt
+touch -d '2001-02-03 04:05:06' psrc/ro/f.txt psrc/ro
+chmod 555 psrc/ro
+for jobs in 1 4; do
+    $PROG -r -p -j $jobs psrc "pdst$jobs"
+    if [ "$(stat -c '%a %Y' psrc/ro)" = "$(stat -c '%a %Y' "pdst$jobs/ro")" ] &&
+       [ "$(stat -c '%a %Y' psrc/ro/f.txt)" = "$(stat -c '%a %Y' "pdst$jobs/ro/f.txt")" ]; then
+        echo "[PASS] -p preserves mode and mtime (-j $jobs)"
+    else
+        echo "[FAIL] -p (-j $jobs)"
+        stat -c '%a %Y %n' psrc/ro psrc/ro/f.txt "pdst$jobs/ro" "pdst$jobs/ro/f.txt"
+        exit 1
+    fi
+    chmod 755 "pdst$jobs/ro"
+done
+chmod 755 psrc/ro
+
+# Test 10: 루프백 btrfs 이미지에서 --reflink=always (root + mkfs.btrfs 가 있을 때만)
+if [ "$(id -u)" -eq 0 ] && command -v mkfs.btrfs > /dev/null; then
+    truncate -s 128M btrfs.img
+    mkdir -p mnt
+    if mkfs.btrfs -q btrfs.img > /dev/null 2>&1 && mount -o loop btrfs.img mnt 2> /dev/null; then
+        cp src/sub/deep/big.bin mnt/orig.bin
+        rc=0
+        $PROG -v --reflink=always mnt/orig.bin mnt/clone.bin > clone.out || rc=$?
+        umount mnt
+        if [ "$rc" -eq 0 ] && grep -q "(reflink)" clone.out; then
+            echo "[PASS] --reflink=always on loopback btrfs"
+        else
+            echo "[FAIL] --reflink=always on loopback btrfs (rc=$rc)"
+            exit 1
+        fi
+    else
+        echo "[SKIP] cannot mount loopback btrfs image"
+    fi
+else
+    echo "[SKIP] loopback btrfs test needs root and mkfs.btrfs"
+fi
+
+# Test 11: --stats=FILE 는 복사 수와 크기 구간별 지연 시간을 JSON 으로 남김
+$PROG -r -j 4 --stats=stats.json src out_stats
+if grep -q '"copied": 3,' stats.json && grep -q '"bytes": 300012,' stats.json &&
+    grep -q '"size": "64KiB-1MiB", "count": 1,' stats.json; then
+    echo "[PASS] --stats writes JSON report"
+else
+    echo "[FAIL] --stats report"
+    cat stats.json || true
+    exit 1
+fi
+
+# Test 12: --direct 는 정렬되지 않은 크기의 큰 파일도 그대로 복사
+head -c 3000001 /dev/urandom > direct_src.bin
+$PROG --direct --buffer-size=256K direct_src.bin direct_dst.bin
+if cmp -s direct_src.bin direct_dst.bin; then
+    echo "[PASS] --direct copies unaligned large file"
+else
+    echo "[FAIL] --direct"
+    exit 1
+fi
+
+# Test 13: --preserve=links 는 하드 링크를 dest 에서도 하드 링크로 (-j 1, -j 4)
+mkdir -p lsrc/x lsrc/y
+head -c 100000 /dev/urandom > lsrc/x/data
+ln lsrc/x/data lsrc/y/link1
+ln lsrc/x/data lsrc/y/link2
+for j in 1 4; do
+    $PROG -r -j "$j" --preserve=links lsrc "ldst$j"
+    if diff -r lsrc "ldst$j" > /dev/null && [ "$(stat -c %h "ldst$j/x/data")" -eq 3 ] &&
+        [ "$(stat -c %i "ldst$j/x/data")" = "$(stat -c %i "ldst$j/y/link2")" ]; then
+        echo "[PASS] --preserve=links keeps hard links (-j $j)"
+    else
+        echo "[FAIL] --preserve=links (-j $j)"
+        exit 1
+    fi
+done
+
+# Test 14: 장치가 다른 큰 파일은 reader/writer 파이프라인으로 복사 (/dev/shm 이 있을 때만)
+if [ -d /dev/shm ] && [ -w /dev/shm ] && [ "$(stat -c %d /dev/shm)" != "$(stat -c %d .)" ]; then
+    head -c 9000000 /dev/urandom > pipe_src.bin
+    shm_dst=$(mktemp -p /dev/shm xcopy_pipe.XXXXXX)
+    rm -f "$shm_dst"
+    $PROG -v pipe_src.bin "$shm_dst" > pipe.out
+    if cmp -s pipe_src.bin "$shm_dst" && grep -q "(pipeline)" pipe.out; then
+        echo "[PASS] cross-device copy uses pipeline"
+    else
+        echo "[FAIL] cross-device pipeline copy"
+        rm -f "$shm_dst"
+        exit 1
+    fi
+    rm -f "$shm_dst"
+else
+    echo "[SKIP] pipeline test needs /dev/shm on another device"
+fi
+
+# Test 15: --verify 는 복사 중 구한 CRC32C 로 dest 를 다시 읽어 확인
+$PROG -r -v --verify src out_verify > verify.out
+if diff -r src out_verify > /dev/null && [ "$(grep -c ', verified)' verify.out)" -eq 3 ]; then
+    echo "[PASS] --verify checks every copied file"
+else
+    echo "[FAIL] --verify"
+    cat verify.out
+    exit 1
+fi
+
+# Test 16: --from-manifest 는 파일 쌍과 디렉터리 쌍을 한 프로세스로 복사 (-j 1, -j 4)
+printf '# deploy\nsrc/a.txt\tmout/files/x/a.txt\nsrc/sub/b.txt\tmout/files/y/b.txt\nsrc\tmout/tree\n' > manifest.txt
+for j in 1 4; do
+    rm -rf mout
+    $PROG -r -j "$j" --from-manifest manifest.txt
+    if cmp -s src/a.txt mout/files/x/a.txt && cmp -s src/sub/b.txt mout/files/y/b.txt &&
+        diff -r src mout/tree > /dev/null; then
+        echo "[PASS] --from-manifest copies all pairs (-j $j)"
+    else
+        echo "[FAIL] --from-manifest (-j $j)"
+        exit 1
+    fi
+done
+
+# Test 17: --direct --verify 는 정렬 단위의 배수 크기(끝까지 O_DIRECT)에서도 확인 성공
+head -c 4194304 /dev/urandom > direct_verify.bin
+if $PROG -v --direct --verify direct_verify.bin direct_verify_copy.bin > direct_verify.out &&
+    cmp -s direct_verify.bin direct_verify_copy.bin && grep -q 'verified)' direct_verify.out; then
+    echo "[PASS] --direct --verify on 4 MiB file"
+else
+    echo "[FAIL] --direct --verify on 4 MiB file"
+    cat direct_verify.out
+    exit 1
+fi
+
+# Cleanup
+cd - > /dev/null
+rm -rf "$TEST_DIR"
+
+echo "All tests completed"
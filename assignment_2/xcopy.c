@@ -1,50 +1,289 @@
+#define _GNU_SOURCE /* copy_file_range */
 #include "apue.h"
 #include <dirent.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <getopt.h>
+#include <limits.h>
+#include <linux/fs.h> /* FICLONE */
+#include <pthread.h>
+#include <stdatomic.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/sendfile.h>
 #include <sys/stat.h>
+#include <sys/xattr.h>
 #include <time.h>
 #include <unistd.h>
+#if defined(__x86_64__)
+#include <nmmintrin.h> /* _mm_crc32_u64 (SSE4.2) */
+#endif
+#ifdef XCOPY_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
 
-#define BUFFSIZE 4096
+#define BUFFSIZE (128 * 1024) /* --checksum 비교 버퍼 */
+#define MIN_IO_BUFFER (64 * 1024) /* read/write 경로 버퍼 크기 범위 */
+#define MAX_IO_BUFFER (1024 * 1024)
+#define IO_BUFFER_BLOCKS 32                /* st_blksize 의 몇 배를 쓸지 */
+#define LARGE_FILE_SIZE (64L << 20)        /* 이보다 크면 MAX_IO_BUFFER */
+#define MAX_BUFFER_SIZE_OPT (64L << 20)    /* --buffer-size 상한 */
+#define DIRECT_MIN_SIZE (1L << 20)         /* --direct 를 적용할 최소 크기 */
+#define DIRECT_ALIGN 4096                  /* O_DIRECT 버퍼/길이 정렬 */
+#define DIRECT_DROP_CHUNK (8L << 20)       /* O_DIRECT 불가 시 캐시 버리는 단위 */
+#define PIPELINE_MIN_SIZE (8L << 20) /* 장치 간 파이프라인 복사를 쓸 최소 크기 */
+#define PIPELINE_BUFFERS 4           /* reader/writer 사이 링의 칸 수 */
+#define KERNEL_COPY_CHUNK (1L << 30) /* copy_file_range/sendfile 1회 요청 크기 */
+#define STRATEGY_CACHE_SIZE 16
 #define DEFAULT_DIRECTORY_MODE 0777
 #define DEFAULT_FILE_MODE 0644
+#define MAX_JOBS 256
+#define TASK_DEQUE_INIT_CAP 64
+#define STATS_SIZE_BUCKETS 5          /* --stats 지연 시간 히스토그램의 크기 구간 */
+#define STATS_LAT_SLOTS (64 * 4)      /* 2의 거듭제곱 구간마다 4칸 */
+#define PROGRESS_INTERVAL_SEC 1
+#define LINK_TABLE_INIT_SIZE 1024 /* --preserve=links inode 표 초기 버킷 수 */
+#define DIR_CACHE_INIT_SIZE 256   /* mkdirs 디렉터리 캐시 초기 칸 수 */
+#define PROGRESS_COPY_CHUNK (16L << 20) /* --progress 때 커널 복사 1회 요청 크기 */
 
 extern int optind;
+extern char *optarg;
 
-bool recursive_opt = false, verbose_opt = false, preserve_opt = false;
+/* --reflink=WHEN: CoW 파일 시스템에서 데이터 대신 extent 를 공유할지 여부 */
+enum reflink_mode { REFLINK_NEVER, REFLINK_AUTO, REFLINK_ALWAYS };
+
+/* --sparse=WHEN: 원본의 구멍(hole)을 dest 에서도 구멍으로 남길지 여부 */
+enum sparse_mode { SPARSE_NEVER, SPARSE_AUTO, SPARSE_ALWAYS };
+
+/* -p / --preserve=LIST 로 보존할 속성들 (비트 마스크) */
+enum preserve_attr {
+    PRESERVE_MODE = 1 << 0,
+    PRESERVE_TIMESTAMPS = 1 << 1,
+    PRESERVE_OWNERSHIP = 1 << 2,
+    PRESERVE_XATTR = 1 << 3,
+    PRESERVE_ACL = 1 << 4,
+    PRESERVE_LINKS = 1 << 5, /* 하드 링크는 dest 에서도 하드 링크로 */
+};
+#define PRESERVE_DEFAULT (PRESERVE_MODE | PRESERVE_TIMESTAMPS) /* -p */
+/* 파일을 만든 뒤 fd 로 적용하는 속성들 (preserve_attributes 가 처리) */
+#define PRESERVE_ATTRS                                                 \
+    (PRESERVE_MODE | PRESERVE_TIMESTAMPS | PRESERVE_OWNERSHIP |        \
+     PRESERVE_XATTR | PRESERVE_ACL)
+#define PRESERVE_ALL (PRESERVE_ATTRS | PRESERVE_LINKS)
+
+/* 짧은 옵션이 없는 긴 옵션들의 getopt_long 반환값 */
+enum long_opt_code {
+    OPT_REFLINK = 256,
+    OPT_UPDATE,
+    OPT_CHECKSUM,
+    OPT_SPARSE,
+    OPT_PRESERVE,
+    OPT_STATS,
+    OPT_PROGRESS,
+    OPT_DIRECT,
+    OPT_BUFFER_SIZE,
+    OPT_VERIFY,
+    OPT_FROM_MANIFEST,
+};
+
+/* 파일 단위 결과 집계 (--update 요약 출력용, 작업자 스레드들이 공유) */
+struct copy_summary {
+    atomic_ulong copied;
+    atomic_ulong skipped;
+    atomic_ulong failed;
+};
+
+bool recursive_opt = false, verbose_opt = false;
+unsigned int preserve_mask = 0; /* enum preserve_attr 조합, 0 이면 보존 안 함 */
+int jobs_opt = 1; /* -j N: 작업자 스레드 수 (1이면 기존 단일 스레드 경로) */
+enum reflink_mode reflink_opt = REFLINK_AUTO;
+enum sparse_mode sparse_opt = SPARSE_AUTO;
+bool update_opt = false;   /* --update/--sync: 바뀐 파일만 복사 */
+bool checksum_opt = false; /* --checksum: mtime 대신 내용으로 비교 */
+struct copy_summary summary;
+bool stats_opt = false;        /* --stats[=FILE]: 끝나고 JSON 보고서 출력 */
+const char *stats_path = NULL; /* NULL 또는 "-" 이면 stdout */
+bool progress_opt = false;     /* --progress: 진행 상황을 stderr 에 주기적으로 */
+bool stats_on = false;         /* 둘 중 하나라도 켜지면 시간을 잼 */
+long copy_chunk = KERNEL_COPY_CHUNK;
+bool direct_opt = false;    /* --direct: 큰 파일은 페이지 캐시를 거치지 않음 */
+size_t buffer_size_opt = 0; /* --buffer-size: 0 이면 파일마다 자동 */
+bool verify_opt = false;    /* --verify: CRC32C 로 dest 를 확인 */
+const char *manifest_path = NULL; /* --from-manifest: SOURCE/TARGET 쌍 목록 */
+
+static const struct option long_options[] = {
+    {"reflink", required_argument, NULL, OPT_REFLINK},
+    {"update", no_argument, NULL, OPT_UPDATE},
+    {"sync", no_argument, NULL, OPT_UPDATE},
+    {"checksum", no_argument, NULL, OPT_CHECKSUM},
+    {"sparse", required_argument, NULL, OPT_SPARSE},
+    {"preserve", optional_argument, NULL, OPT_PRESERVE},
+    {"stats", optional_argument, NULL, OPT_STATS},
+    {"progress", no_argument, NULL, OPT_PROGRESS},
+    {"direct", no_argument, NULL, OPT_DIRECT},
+    {"buffer-size", required_argument, NULL, OPT_BUFFER_SIZE},
+    {"verify", no_argument, NULL, OPT_VERIFY},
+    {"from-manifest", required_argument, NULL, OPT_FROM_MANIFEST},
+    {NULL, 0, NULL, 0},
+};
 
 static void print_usage(const char *argv0) {
-    fprintf(stderr, "Usage: %s [-r] [-v] [-p] SOURCE TARGET\n", argv0);
+    fprintf(stderr,
+            "Usage: %s [-r] [-v] [-p] [-j N] [--reflink=WHEN] "
+            "[--update [--checksum]] [--sparse=WHEN] [--preserve[=LIST]]\n"
+            "       [--stats[=FILE]] [--progress] [--direct] "
+            "[--buffer-size=SIZE] [--verify]\n"
+            "       SOURCE TARGET | --from-manifest FILE\n"
+            "  -p                           same as --preserve=mode,timestamps\n"
+            "  --preserve[=LIST]            mode,timestamps,ownership,xattr,"
+            "acl,links or all\n"
+            "  --reflink=auto|always|never  clone extents on CoW filesystems "
+            "(default: auto)\n"
+            "  --sparse=auto|always|never   keep holes of sparse SOURCE files; "
+            "always also\n"
+            "                               turns zero blocks into holes "
+            "(default: auto)\n"
+            "  --update, --sync             skip files whose TARGET has the "
+            "same size and is not older\n"
+            "  --checksum                   with --update, compare contents "
+            "instead of mtime\n"
+            "  --stats[=FILE]               write a JSON report (throughput, "
+            "latency per size,\n"
+            "                               data/metadata time) to FILE or "
+            "stdout\n"
+            "  --progress                   print files, bytes and rates to "
+            "stderr every second\n"
+            "  --direct                     copy files of 1MiB or more with "
+            "O_DIRECT so the\n"
+            "                               page cache is left alone\n"
+            "  --buffer-size=SIZE           read/write buffer, e.g. 256K or "
+            "4M (default: from\n"
+            "                               block size and file size)\n"
+            "  --verify                     checksum (CRC32C) data while "
+            "copying, then re-read\n"
+            "                               TARGET from disk and compare\n"
+            "  --from-manifest FILE         copy every \"SOURCE<TAB>TARGET\" "
+            "line of FILE\n"
+            "                               (- for stdin) in this process\n",
+            argv0);
+}
+// "4096", "256K", "4M" 같은 크기를 바이트로 바꿉니다. 에러면 -1
+static int parse_size(const char *arg, size_t *size) {
+    char *end;
+    unsigned long n;
+    int shift = 0;
+
+    if (arg[0] == '-') return -1; /* strtoul 은 "-1" 도 큰 양수로 받음 */
+    errno = 0;
+    n = strtoul(arg, &end, 10);
+    if (errno != 0 || end == arg) return -1;
+    if (*end == 'K' || *end == 'k') {
+        shift = 10;
+        end++;
+    } else if (*end == 'M' || *end == 'm') {
+        shift = 20;
+        end++;
+    }
+    if (*end != '\0') return -1;
+    if (n > ULONG_MAX >> shift) return -1; /* 넘치면 범위 안으로 돌아올 수 있음 */
+    n <<= shift;
+    *size = n;
+    return 0;
+}
+// "mode,timestamps,..." 을 enum preserve_attr 마스크로 바꿉니다. 에러면 -1
+static int parse_preserve_list(const char *list, unsigned int *mask) {
+    static const struct {
+        const char *name;
+        unsigned int bits;
+    } attrs[] = {
+        {"mode", PRESERVE_MODE},         {"timestamps", PRESERVE_TIMESTAMPS},
+        {"ownership", PRESERVE_OWNERSHIP}, {"xattr", PRESERVE_XATTR},
+        {"acl", PRESERVE_ACL},           {"links", PRESERVE_LINKS},
+        {"all", PRESERVE_ALL},
+    };
+    const char *p = list;
+
+    while (*p) {
+        size_t len = strcspn(p, ",");
+        size_t i;
+        for (i = 0; i < sizeof(attrs) / sizeof(attrs[0]); i++) {
+            if (strlen(attrs[i].name) == len &&
+                strncmp(p, attrs[i].name, len) == 0)
+                break;
+        }
+        if (i == sizeof(attrs) / sizeof(attrs[0])) return -1;
+        *mask |= attrs[i].bits;
+        p += len;
+        if (*p == ',') p++;
+    }
+    return 0;
 }
 static void print_skip_symlink_message(const char *path) {
     fprintf(stderr, "skip symlinks: %s\n", path);
 }
-static void print_verbose_message(const char *src, const char *dest) {
-    printf("복사 중: %s -> %s\n", src, dest);
+static void print_verbose_message(const char *src, const char *dest,
+                                  const char *how) {
+    printf("복사 중: %s -> %s (%s)\n", src, dest, how);
+}
+static void print_unchanged_message(const char *src, const char *dest) {
+    printf("건너뜀: %s -> %s (unchanged)\n", src, dest);
+}
+static void print_summary(void) {
+    printf("copied: %lu, skipped: %lu, failed: %lu\n",
+           atomic_load(&summary.copied), atomic_load(&summary.skipped),
+           atomic_load(&summary.failed));
 }
 
 int copy_entry(const char *src, const char *dest);
+int copy_directory_tree(const char *src, const char *dest);
 int copy_directory_recursive(const char *src, const char *dest);
+int copy_directory_parallel(const char *src, const char *dest, int nworkers);
+int copy_manifest(const char *path);
+int copy_manifest_pair(const char *src, const char *dest);
 int copy_file(const char *src, const char *dest);
+int copy_file_at(int src_dfd, const char *src_name, int dst_dfd,
+                 const char *dst_name, const char *src, const char *dest);
+int dest_is_up_to_date(int in, const struct stat *st_in, int dst_dfd,
+                       const char *dst_name);
+int copy_file_data(int in, int out, const struct stat *st_in,
+                   const struct stat *st_out, const char **how);
 int safe_mkdir(const char *path, mode_t mode);
 int mkdirs(const char *dir_path);
-int preserve_file_attributes(const char *src, const char *dest);
-int process_preserve(const char *src, const char *dest);
-bool file_exists(const char *path);
+int preserve_attributes(int src_fd, int dst_fd, const struct stat *st,
+                        const char *dest);
+unsigned long stats_clock(void);
+void stats_add_dir(unsigned long t0);
+void stats_progress(ssize_t n);
+void stats_add_file(bool copied, off_t size, unsigned long ns,
+                    unsigned long data_ns);
+void stats_start(void);
+int stats_finish(void);
+void link_table_free(void);
+void dir_cache_free(void);
+void crc32c_init(void);
+void verify_begin(void);
+void verify_update(const void *buf, size_t len);
+void verify_zeros(off_t len);
+int verify_dest(int out, const char *dest);
+void raise_fd_limit(void);
 char *concat_path(const char *src, const char *name);
 mode_t get_permission_bits(mode_t st_mode);
 
 int main(int argc, char *argv[]) {
     int opt;
 
-    // optstring: r, v, p 모두 인자 없음
+    // optstring: r, v, p 는 인자 없음, j 는 작업자 수를 인자로 받음
     // 앞에 '+'를 붙이면 첫 비옵션에서 파싱을 멈추는 POSIX 모드
-    while ((opt = getopt(argc, argv, "+rvp")) != -1) {
+    // 긴 옵션(--reflink 등)은 long_options 참고
+    while ((opt = getopt_long(argc, argv, "+rvpj:", long_options, NULL)) !=
+           -1) {
         switch (opt) {
             case 'r':
                 recursive_opt = true;
@@ -53,7 +292,88 @@ int main(int argc, char *argv[]) {
                 verbose_opt = true;
                 break;
             case 'p':
-                preserve_opt = true;
+                preserve_mask |= PRESERVE_DEFAULT;
+                break;
+            case 'j': {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n < 1 || n > MAX_JOBS) {
+                    fprintf(stderr, "-j: worker count must be 1..%d\n",
+                            MAX_JOBS);
+                    print_usage(argv[0]);
+                    return 2;
+                }
+                jobs_opt = (int)n;
+                break;
+            }
+            case OPT_REFLINK:
+                if (strcmp(optarg, "auto") == 0) {
+                    reflink_opt = REFLINK_AUTO;
+                } else if (strcmp(optarg, "always") == 0) {
+                    reflink_opt = REFLINK_ALWAYS;
+                } else if (strcmp(optarg, "never") == 0) {
+                    reflink_opt = REFLINK_NEVER;
+                } else {
+                    fprintf(stderr, "--reflink: invalid argument '%s'\n",
+                            optarg);
+                    print_usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case OPT_SPARSE:
+                if (strcmp(optarg, "auto") == 0) {
+                    sparse_opt = SPARSE_AUTO;
+                } else if (strcmp(optarg, "always") == 0) {
+                    sparse_opt = SPARSE_ALWAYS;
+                } else if (strcmp(optarg, "never") == 0) {
+                    sparse_opt = SPARSE_NEVER;
+                } else {
+                    fprintf(stderr, "--sparse: invalid argument '%s'\n",
+                            optarg);
+                    print_usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case OPT_PRESERVE:
+                if (!optarg) {
+                    preserve_mask |= PRESERVE_DEFAULT;
+                } else if (parse_preserve_list(optarg, &preserve_mask) != 0) {
+                    fprintf(stderr, "--preserve: invalid list '%s'\n", optarg);
+                    print_usage(argv[0]);
+                    return 2;
+                }
+                break;
+            case OPT_UPDATE:
+                update_opt = true;
+                break;
+            case OPT_CHECKSUM:
+                checksum_opt = true;
+                break;
+            case OPT_STATS:
+                stats_opt = true;
+                stats_path = optarg;
+                break;
+            case OPT_PROGRESS:
+                progress_opt = true;
+                break;
+            case OPT_DIRECT:
+                direct_opt = true;
+                break;
+            case OPT_VERIFY:
+                verify_opt = true;
+                break;
+            case OPT_FROM_MANIFEST:
+                manifest_path = optarg;
+                break;
+            case OPT_BUFFER_SIZE:
+                if (parse_size(optarg, &buffer_size_opt) != 0 ||
+                    buffer_size_opt < DIRECT_ALIGN ||
+                    buffer_size_opt > MAX_BUFFER_SIZE_OPT) {
+                    fprintf(stderr, "--buffer-size: must be 4K..%ldM\n",
+                            MAX_BUFFER_SIZE_OPT >> 20);
+                    print_usage(argv[0]);
+                    return 2;
+                }
                 break;
             case '?': /* 미지정 옵션 */
             default:
@@ -62,15 +382,42 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    // 남은 비옵션 인자: SOURCE, DEST
-    if (argc - optind != 2) {
+    // 남은 비옵션 인자: SOURCE, DEST (--from-manifest 면 없어야 함)
+    if (argc - optind != (manifest_path ? 0 : 2)) {
         print_usage(argv[0]);
         return 2;
     }
-    const char *src = argv[optind];
-    const char *dest = argv[optind + 1];
+    const char *src = manifest_path ? NULL : argv[optind];
+    const char *dest = manifest_path ? NULL : argv[optind + 1];
 
-    if (copy_entry(src, dest) != 0) {
+    if (checksum_opt && !update_opt) {
+        fprintf(stderr, "--checksum requires --update\n");
+        print_usage(argv[0]);
+        return 2;
+    }
+    if (verify_opt && reflink_opt == REFLINK_ALWAYS) {
+        /* reflink 는 데이터를 읽지 않으므로 복사 중에 CRC 를 구할 수 없음 */
+        fprintf(stderr, "--verify cannot be used with --reflink=always\n");
+        print_usage(argv[0]);
+        return 2;
+    }
+    if (verify_opt) crc32c_init();
+
+    /* 디렉터리 fd 를 깊이만큼 열어 두므로 fd 한도를 최대로 올려 둡니다. */
+    if (recursive_opt) raise_fd_limit();
+
+    stats_on = stats_opt || progress_opt;
+    /* 큰 파일도 진행 상황이 보이도록 커널 복사를 잘게 나눔 */
+    if (progress_opt) copy_chunk = PROGRESS_COPY_CHUNK;
+    if (stats_on) stats_start();
+
+    int ret = manifest_path ? copy_manifest(manifest_path)
+                            : copy_entry(src, dest);
+    link_table_free();
+    dir_cache_free();
+    if (stats_on && stats_finish() != 0) ret = -1;
+    if (update_opt) print_summary();
+    if (ret != 0) {
         fprintf(stderr, "copy failed\n");
         return 1;
     }
@@ -110,7 +457,7 @@ int copy_entry(const char *src, const char *dest) {
             }
 
             // src가 디렉터리이고 dest가 없을 때 재귀적으로 복사
-            if (copy_directory_recursive(src, dest) != 0) {
+            if (copy_directory_tree(src, dest) != 0) {
                 fprintf(stderr, "copy_directory_recursive error: %s -> %s\n",
                         src, dest);
                 return -1;
@@ -124,7 +471,7 @@ int copy_entry(const char *src, const char *dest) {
             return -1;
         } else if (S_ISDIR(st_dst.st_mode)) {
             // src와 dest 모두 디렉터리인 경우, 재귀적으로 복사
-            if (copy_directory_recursive(src, dest) != 0) {
+            if (copy_directory_tree(src, dest) != 0) {
                 fprintf(stderr, "copy_directory_recursive error: %s -> %s\n",
                         src, dest);
                 return -1;
@@ -135,7 +482,8 @@ int copy_entry(const char *src, const char *dest) {
         // src가 정규 파일인 경우
         struct stat st_dst;
 
-        if (recursive_opt) {
+        /* 매니페스트에는 파일 쌍과 디렉터리 쌍이 섞여 있을 수 있음 */
+        if (recursive_opt && !manifest_path) {
             fprintf(stderr,
                     "with -r, SOURCE must be a directory (got a file)\n");
             return -1;
@@ -169,268 +517,2669 @@ int copy_entry(const char *src, const char *dest) {
         return -1;
     }
 
-    // -p 옵션이 켜져있다면, 파일 및 디렉터리 복사 이후에 속성까지 복사합니다.
-    if (preserve_opt) {
-        if (process_preserve(src, dest) != 0) {
-            fprintf(stderr, "process_preserve error: %s -> %s\n", src, dest);
-            return -1;
-        }
-    }
+    /*
+     * -p 속성 보존은 복사하면서 함께 처리됩니다. 파일은 데이터를 쓴 직후
+     * 열려 있는 fd 로, 디렉터리는 하위 항목을 모두 복사한 뒤에 맞춥니다.
+     */
+    return 0;
+}
 
+/*
+ * 화면 출력/에러 메시지용 경로 버퍼
+ *
+ * 실제 파일 접근은 디렉터리 fd 기준 상대 경로(openat 등)로 하므로, 전체
+ * 경로 문자열은 메시지에만 필요합니다. 하나의 버퍼에 "/이름" 을 붙였다가
+ * 다시 잘라내는 식으로 재사용하므로 항목마다 malloc 하지 않습니다.
+ * (버퍼가 부족할 때만 두 배로 늘림)
+ */
+struct path_buf {
+    char *buf;
+    size_t len;
+    size_t cap;
+};
+
+static int path_reserve(struct path_buf *p, size_t need) {
+    if (need <= p->cap) return 0;
+    size_t cap = p->cap ? p->cap : 256;
+    while (cap < need) cap *= 2;
+    char *nb = realloc(p->buf, cap);
+    if (!nb) return -1;
+    p->buf = nb;
+    p->cap = cap;
     return 0;
 }
 
-int copy_directory_recursive(const char *src, const char *dest) {
-    DIR *dp;
-    struct dirent *dirp;
+static int path_set(struct path_buf *p, const char *s) {
+    size_t n = strlen(s);
+    if (path_reserve(p, n + 1) != 0) return -1;
+    memcpy(p->buf, s, n + 1);
+    p->len = n;
+    return 0;
+}
+
+// p 뒤에 "/name" 을 붙입니다. *saved 에 원래 길이를 돌려주므로
+// path_pop(p, *saved) 로 되돌릴 수 있습니다.
+static int path_push(struct path_buf *p, const char *name, size_t *saved) {
+    size_t n = strlen(name);
+    if (path_reserve(p, p->len + 1 + n + 1) != 0) return -1;
+    *saved = p->len;
+    p->buf[p->len++] = '/';
+    memcpy(p->buf + p->len, name, n + 1);
+    p->len += n;
+    return 0;
+}
+
+static void path_pop(struct path_buf *p, size_t saved) {
+    p->len = saved;
+    p->buf[saved] = '\0';
+}
+
+static void path_free(struct path_buf *p) {
+    free(p->buf);
+    p->buf = NULL;
+    p->len = p->cap = 0;
+}
+
+// 디렉터리를 dfd 기준으로 엽니다. 심볼릭 링크는 따라가지 않습니다.
+static int open_dir_at(int dfd, const char *name) {
+    unsigned long t0 = stats_clock();
+    int fd = openat(dfd, name, O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+    stats_add_dir(t0);
+    return fd;
+}
+
+// dirent 의 파일 종류를 돌려줍니다. d_type 을 채워주지 않는 파일 시스템에서만
+// fstatat 을 부릅니다. 에러면 -1
+static int dirent_type(int dfd, const struct dirent *d) {
     struct stat st;
 
-    if (lstat(src, &st) != 0) {
-        perror("lstat src");
+    if (d->d_type != DT_UNKNOWN) return d->d_type;
+    if (fstatat(dfd, d->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0) return -1;
+    if (S_ISLNK(st.st_mode)) return DT_LNK;
+    if (S_ISDIR(st.st_mode)) return DT_DIR;
+    if (S_ISREG(st.st_mode)) return DT_REG;
+    return DT_UNKNOWN;
+}
+
+// dfd 아래에 디렉터리 name 이 있도록 보장합니다. (safe_mkdir 의 fd 버전)
+// 대부분은 새로 만드는 경우라 mkdirat 을 먼저 시도하고, 이미 있을 때만
+// 디렉터리인지 확인합니다.
+static int ensure_dir_at(int dfd, const char *name, mode_t mode) {
+    struct stat st;
+    unsigned long t0 = stats_clock();
+    int ret = 0;
+
+    if (mkdirat(dfd, name, mode) != 0) {
+        if (errno != EEXIST ||
+            fstatat(dfd, name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            ret = -1;
+        else if (!S_ISDIR(st.st_mode))
+            ret = -1;
+    }
+    stats_add_dir(t0);
+    return ret;
+}
+
+#ifdef XCOPY_IO_URING
+/*
+ * io_uring 일괄 복사 백엔드 (빌드 시 -DXCOPY_IO_URING)
+ *
+ * 작은 파일 하나를 복사하는 데 open, read, open, write, close, close 의
+ * 블로킹 시스템 콜이 필요합니다. 이 백엔드는 한 디렉터리의 작은 파일들을
+ * URING_BATCH 개씩 모아 두 번의 io_uring_enter 로 처리합니다.
+ *
+ * 1단계: [OPENAT src → READ] 체인을 파일마다 넣고 한꺼번에 제출
+ * 2단계: 읽은 크기로 [OPENAT dest → WRITE → CLOSE dest] 체인과
+ *        CLOSE src 를 넣고 한꺼번에 제출
+ *
+ * 열린 파일은 일반 fd 대신 등록된 파일 테이블 slot(direct descriptor)에
+ * 두므로, 체인 안에서 앞 SQE 가 연 파일을 뒤 SQE 가 바로 쓸 수 있습니다.
+ * 파일 i 의 원본은 slot 2i, dest 는 slot 2i+1 입니다.
+ *
+ * 버퍼(URING_FILE_MAX)보다 큰 파일, dest 가 이미 있는 파일, 에러가 난
+ * 파일은 기존 copy_file_at 경로로 다시 처리하므로 메시지와 결과는 같습니다.
+ * 커널이 io_uring 을 지원하지 않으면 (ENOSYS, seccomp 의 EPERM 등)
+ * 처음부터 기존 경로를 씁니다. liburing 없이 시스템 콜을 직접 부릅니다.
+ */
+#define URING_BATCH 32
+#define URING_FILE_MAX (64 * 1024)
+#define URING_ENTRIES (URING_BATCH * 4) /* 2단계: 파일당 SQE 최대 4개 */
+
+enum uring_op {
+    URING_OPEN_SRC,
+    URING_READ,
+    URING_OPEN_DST,
+    URING_WRITE,
+    URING_CLOSE_DST,
+    URING_CLOSE_SRC,
+};
+
+struct uring {
+    int fd;
+    unsigned int *sq_tail, *sq_mask;
+    unsigned int *cq_head, *cq_tail, *cq_mask;
+    unsigned int sq_local_tail; /* 아직 커널에 알리지 않은 tail */
+    struct io_uring_sqe *sqes;
+    struct io_uring_cqe *cqes;
+    void *ring_ptr;
+    size_t ring_sz;
+    size_t sqes_sz;
+};
+
+struct uring_entry {
+    char name[NAME_MAX + 1];
+    int src_res; /* 원본 OPENAT 결과 (0 이면 slot 에 열림) */
+    int dst_res; /* dest OPENAT/WRITE/CLOSE 중 첫 에러 (-errno) */
+    ssize_t nread;
+    bool fallback; /* 기존 경로로 다시 처리 */
+};
+
+struct uring_batch {
+    struct uring ring;
+    int src_dfd, dst_dfd;
+    int n;
+    char *bufs; /* 파일마다 URING_FILE_MAX */
+    struct uring_entry ents[URING_BATCH];
+};
+
+static struct uring_batch *uring_batch; /* NULL 이면 io_uring 미사용 */
+
+static int uring_setup(struct uring *r) {
+    struct io_uring_params p;
+    int fds[URING_BATCH * 2];
+
+    memset(&p, 0, sizeof(p));
+    r->fd = (int)syscall(__NR_io_uring_setup, URING_ENTRIES, &p);
+    if (r->fd < 0) return -1;
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP)) {
+        close(r->fd);
+        errno = ENOSYS;
         return -1;
     }
 
-    if (!S_ISDIR(st.st_mode)) {
-        fprintf(stderr, "recurv: %s is not a directory\n", src);
+    /* SQ/CQ 링은 한 번의 mmap 으로 공유됨 (IORING_FEAT_SINGLE_MMAP) */
+    r->ring_sz = p.sq_off.array + p.sq_entries * sizeof(unsigned int);
+    if (p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe) >
+        r->ring_sz)
+        r->ring_sz = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    r->ring_ptr = mmap(NULL, r->ring_sz, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQ_RING);
+    if (r->ring_ptr == MAP_FAILED) {
+        close(r->fd);
+        return -1;
+    }
+    r->sqes_sz = p.sq_entries * sizeof(struct io_uring_sqe);
+    r->sqes = mmap(NULL, r->sqes_sz, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_SQES);
+    if (r->sqes == MAP_FAILED) {
+        munmap(r->ring_ptr, r->ring_sz);
+        close(r->fd);
         return -1;
     }
 
-    if ((dp = opendir(src)) == NULL) {
-        perror("opendir");
+    char *ring = r->ring_ptr;
+    r->sq_tail = (unsigned int *)(ring + p.sq_off.tail);
+    r->sq_mask = (unsigned int *)(ring + p.sq_off.ring_mask);
+    r->cq_head = (unsigned int *)(ring + p.cq_off.head);
+    r->cq_tail = (unsigned int *)(ring + p.cq_off.tail);
+    r->cq_mask = (unsigned int *)(ring + p.cq_off.ring_mask);
+    r->cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+    r->sq_local_tail = *r->sq_tail;
+
+    /* SQ 배열은 항상 "i 번째 칸 = i 번째 SQE" 로 고정 */
+    unsigned int *array = (unsigned int *)(ring + p.sq_off.array);
+    for (unsigned int i = 0; i < p.sq_entries; i++) array[i] = i;
+
+    /* 빈 파일 테이블을 등록해 두고 OPENAT 이 slot 에 직접 열게 함 */
+    for (int i = 0; i < URING_BATCH * 2; i++) fds[i] = -1;
+    if (syscall(__NR_io_uring_register, r->fd, IORING_REGISTER_FILES, fds,
+                URING_BATCH * 2) < 0) {
+        munmap(r->sqes, r->sqes_sz);
+        munmap(r->ring_ptr, r->ring_sz);
+        close(r->fd);
         return -1;
     }
-    while ((dirp = readdir(dp)) != NULL) {
-        struct stat child_st;
-        char *child_src, *child_dest;
+    return 0;
+}
 
-        if (strcmp(dirp->d_name, ".") == 0 || strcmp(dirp->d_name, "..") == 0)
-            continue; /* ignore dot and dot-dot */
+static void uring_teardown(struct uring *r) {
+    munmap(r->sqes, r->sqes_sz);
+    munmap(r->ring_ptr, r->ring_sz);
+    close(r->fd);
+}
+
+static struct io_uring_sqe *uring_get_sqe(struct uring *r, enum uring_op op,
+                                          int idx) {
+    struct io_uring_sqe *sqe = &r->sqes[r->sq_local_tail & *r->sq_mask];
+    r->sq_local_tail++;
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->user_data = ((__u64)idx << 8) | op;
+    return sqe;
+}
+
+// 쌓아 둔 SQE 를 모두 제출하고, SQE 마다 하나씩 오는 CQE 를 모두 받아
+// on_cqe 로 넘깁니다.
+static int uring_run(struct uring_batch *b,
+                     void (*on_cqe)(struct uring_batch *, enum uring_op, int,
+                                    int)) {
+    struct uring *r = &b->ring;
+    unsigned int to_submit = r->sq_local_tail - *r->sq_tail;
+    unsigned int expected = to_submit, done = 0;
 
-        child_src = concat_path(src, dirp->d_name);
-        child_dest = concat_path(dest, dirp->d_name);
-        if (!child_src || !child_dest) {
-            perror("alloc_path_concat");
-            if (child_src) free(child_src);
-            if (child_dest) free(child_dest);
-            closedir(dp);
+    __atomic_store_n(r->sq_tail, r->sq_local_tail, __ATOMIC_RELEASE);
+    while (done < expected) {
+        int n = (int)syscall(__NR_io_uring_enter, r->fd, to_submit, 1,
+                             IORING_ENTER_GETEVENTS, NULL, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror("io_uring_enter");
             return -1;
         }
+        to_submit -= (unsigned int)n;
 
-        if (lstat(child_src, &child_st) != 0) {
-            perror("lstat");
-            free(child_src);
-            free(child_dest);
-            closedir(dp);
-            return -1;
-        } else if (S_ISLNK(child_st.st_mode)) {
-            print_skip_symlink_message(child_src);
-            free(child_src);
-            free(child_dest);
+        unsigned int head = *r->cq_head;
+        unsigned int tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; head++, done++) {
+            struct io_uring_cqe *cqe = &r->cqes[head & *r->cq_mask];
+            on_cqe(b, (enum uring_op)(cqe->user_data & 0xff),
+                   (int)(cqe->user_data >> 8), cqe->res);
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+static void uring_read_done(struct uring_batch *b, enum uring_op op, int i,
+                            int res) {
+    struct uring_entry *e = &b->ents[i];
+    if (op == URING_OPEN_SRC) {
+        e->src_res = res;
+    } else if (op == URING_READ) {
+        e->nread = res;
+        /* 에러, 또는 버퍼를 꽉 채움(더 클 수 있음) → 기존 경로로 */
+        if (res < 0 || res == URING_FILE_MAX) e->fallback = true;
+    }
+}
+
+static void uring_write_done(struct uring_batch *b, enum uring_op op, int i,
+                             int res) {
+    struct uring_entry *e = &b->ents[i];
+    if (op == URING_OPEN_DST) {
+        /* dest 가 이미 있으면 경고 후 덮어쓰기를 기존 경로가 처리 */
+        if (res < 0) e->fallback = true;
+    } else if (op == URING_WRITE) {
+        if (res < 0 && e->dst_res == 0 && !e->fallback) e->dst_res = res;
+        else if (res >= 0 && res != e->nread && e->dst_res == 0)
+            e->dst_res = -EIO; /* short write */
+    } else if (op == URING_CLOSE_DST) {
+        if (res < 0 && e->dst_res == 0 && !e->fallback) e->dst_res = res;
+    }
+}
+
+// 모아 둔 파일들을 복사합니다. sp, dp 는 이 디렉터리의 메시지용 경로입니다.
+static int uring_batch_flush(struct uring_batch *b, struct path_buf *sp,
+                             struct path_buf *dp) {
+    struct uring *r = &b->ring;
+    struct io_uring_sqe *sqe;
+    int i, n = b->n, ret = 0;
+    unsigned long t0 = stats_clock(), per_file = 0;
+
+    if (n == 0) return 0;
+    b->n = 0;
+
+    /* 1단계: 원본 열기 → 읽기 */
+    for (i = 0; i < n; i++) {
+        struct uring_entry *e = &b->ents[i];
+        e->src_res = e->dst_res = 0;
+        e->nread = 0;
+        e->fallback = false;
+
+        sqe = uring_get_sqe(r, URING_OPEN_SRC, i);
+        sqe->opcode = IORING_OP_OPENAT;
+        sqe->fd = b->src_dfd;
+        sqe->addr = (__u64)(uintptr_t)e->name;
+        sqe->open_flags = O_RDONLY;
+        sqe->file_index = 2 * i + 1; /* slot 2i (0 은 "slot 아님") */
+        sqe->flags = IOSQE_IO_LINK;
+
+        sqe = uring_get_sqe(r, URING_READ, i);
+        sqe->opcode = IORING_OP_READ;
+        sqe->fd = 2 * i;
+        sqe->flags = IOSQE_FIXED_FILE;
+        sqe->addr = (__u64)(uintptr_t)(b->bufs + (size_t)i * URING_FILE_MAX);
+        sqe->len = URING_FILE_MAX;
+        sqe->off = 0;
+    }
+    if (uring_run(b, uring_read_done) != 0) return -1;
+
+    /* 2단계: dest 열기 → 쓰기 → 닫기 (쓰기가 실패해도 닫도록 HARDLINK) */
+    for (i = 0; i < n; i++) {
+        struct uring_entry *e = &b->ents[i];
+        if (e->src_res < 0) {
+            e->fallback = true;
             continue;
-        } else if (S_ISDIR(child_st.st_mode)) {
-            /* ensure directory on dest side */
-            if (safe_mkdir(child_dest, DEFAULT_DIRECTORY_MODE) != 0) {
-                fprintf(stderr, "safe_mkdir error: %s\n", child_dest);
-                free(child_src);
-                free(child_dest);
-                return -1;
-            }
+        }
+        if (!e->fallback) {
+            sqe = uring_get_sqe(r, URING_OPEN_DST, i);
+            sqe->opcode = IORING_OP_OPENAT;
+            sqe->fd = b->dst_dfd;
+            sqe->addr = (__u64)(uintptr_t)e->name;
+            sqe->open_flags = O_WRONLY | O_CREAT | O_EXCL;
+            sqe->len = DEFAULT_FILE_MODE;
+            sqe->file_index = 2 * i + 2; /* slot 2i+1 */
+            sqe->flags = IOSQE_IO_LINK;
 
-            /* recursive call */
-            if (copy_directory_recursive(child_src, child_dest) != 0) {
-                free(child_src);
-                free(child_dest);
-                closedir(dp);
-                return -1;
-            }
-        } else if (S_ISREG(child_st.st_mode)) {
-            /* copy file */
-            if (copy_file(child_src, child_dest) != 0) {
-                free(child_src);
-                free(child_dest);
-                closedir(dp);
-                return -1;
-            }
+            sqe = uring_get_sqe(r, URING_WRITE, i);
+            sqe->opcode = IORING_OP_WRITE;
+            sqe->fd = 2 * i + 1;
+            sqe->flags = IOSQE_FIXED_FILE | IOSQE_IO_HARDLINK;
+            sqe->addr =
+                (__u64)(uintptr_t)(b->bufs + (size_t)i * URING_FILE_MAX);
+            sqe->len = (unsigned int)e->nread;
+            sqe->off = 0;
+
+            sqe = uring_get_sqe(r, URING_CLOSE_DST, i);
+            sqe->opcode = IORING_OP_CLOSE;
+            sqe->file_index = 2 * i + 2;
         }
-        free(child_src);
-        free(child_dest);
+        sqe = uring_get_sqe(r, URING_CLOSE_SRC, i);
+        sqe->opcode = IORING_OP_CLOSE;
+        sqe->file_index = 2 * i + 1;
     }
+    if (uring_run(b, uring_write_done) != 0) return -1;
+    /* 파일별 시간을 나눌 수 없으므로 배치 시간을 고르게 나눠 기록 */
+    if (stats_on) per_file = (stats_clock() - t0) / (unsigned long)n;
 
-    if (closedir(dp) < 0) {
-        perror("closedir");
-        return -1;
+    for (i = 0; i < n; i++) {
+        struct uring_entry *e = &b->ents[i];
+        size_t s_saved, d_saved;
+
+        if (path_push(sp, e->name, &s_saved) != 0 ||
+            path_push(dp, e->name, &d_saved) != 0) {
+            perror("path_push");
+            return -1;
+        }
+        if (e->fallback) {
+            if (copy_file_at(b->src_dfd, e->name, b->dst_dfd, e->name,
+                             sp->buf, dp->buf) != 0)
+                ret = -1;
+        } else if (e->dst_res < 0) {
+            errno = -e->dst_res;
+            perror("write");
+            fprintf(stderr, "copy_file error: %s -> %s\n", sp->buf, dp->buf);
+            atomic_fetch_add(&summary.failed, 1);
+            ret = -1;
+        } else {
+            if (verbose_opt) print_verbose_message(sp->buf, dp->buf, "io_uring");
+            atomic_fetch_add(&summary.copied, 1);
+            stats_add_file(true, e->nread, per_file, per_file);
+        }
+        path_pop(sp, s_saved);
+        path_pop(dp, d_saved);
     }
+    return ret;
+}
+
+// 파일 하나를 배치에 넣습니다. 배치가 가득 차면 먼저 비웁니다.
+// 호출하는 쪽은 디렉터리를 옮기기 전에 uring_batch_flush 를 불러야 합니다.
+static int uring_batch_add(struct uring_batch *b, int src_dfd, int dst_dfd,
+                           const char *name, struct path_buf *sp,
+                           struct path_buf *dp) {
+    if (b->n == URING_BATCH && uring_batch_flush(b, sp, dp) != 0) return -1;
+    b->src_dfd = src_dfd;
+    b->dst_dfd = dst_dfd;
+    snprintf(b->ents[b->n].name, sizeof(b->ents[0].name), "%s", name);
+    b->n++;
     return 0;
 }
-int copy_file(const char *src, const char *dest) {
-    int n;
-    int in, out;
-    char *buf[BUFFSIZE];
 
-    if (verbose_opt) {
-        print_verbose_message(src, dest);
+// 지금 옵션 조합에서 io_uring 경로를 쓸 수 있으면 배치를 만듭니다.
+// 파일마다 판단이 필요한 옵션(--update, -p 등)이 있으면 쓰지 않습니다.
+static struct uring_batch *uring_batch_new(void) {
+    struct uring_batch *b;
+
+    if (update_opt || preserve_mask || verify_opt ||
+        reflink_opt == REFLINK_ALWAYS || sparse_opt == SPARSE_ALWAYS)
+        return NULL;
+    if ((b = calloc(1, sizeof(*b))) == NULL) return NULL;
+    if ((b->bufs = malloc((size_t)URING_BATCH * URING_FILE_MAX)) == NULL) {
+        free(b);
+        return NULL;
+    }
+    if (uring_setup(&b->ring) != 0) {
+        /* 커널/seccomp 가 막으면 조용히 기존 경로 사용 */
+        free(b->bufs);
+        free(b);
+        return NULL;
     }
+    return b;
+}
 
-    in = open(src, O_RDONLY);
-    if (in < 0) {
-        perror("open src");
+static void uring_batch_free(struct uring_batch *b) {
+    if (!b) return;
+    uring_teardown(&b->ring);
+    free(b->bufs);
+    free(b);
+}
+#endif /* XCOPY_IO_URING */
+
+// 열려 있는 src/dest 디렉터리 fd 를 기준으로 재귀 복사합니다.
+// sfd, dfd 는 이 함수가 닫습니다. sp, dp 는 메시지용 경로입니다.
+// preserve_self 면 하위 항목을 모두 복사한 뒤 이 디렉터리의 속성도 맞춥니다.
+// (하위 항목을 만들면 디렉터리 mtime 이 바뀌므로 반드시 마지막에)
+static int copy_dir_fd(int sfd, int dfd, struct path_buf *sp,
+                       struct path_buf *dp, bool preserve_self) {
+    DIR *dir;
+    struct dirent *dirp;
+    struct stat st_dir;
+    int ret = 0;
+
+    if (preserve_self && fstat(sfd, &st_dir) != 0) {
+        perror("fstat src dir");
+        close(sfd);
+        close(dfd);
         return -1;
     }
 
-    /* Check if destination file exists and print warning */
-    if (file_exists(dest)) {
-        fprintf(stderr, "Warning: File '%s' already exists.\n", dest);
-    }
-    out = open(dest, O_WRONLY | O_CREAT | O_TRUNC, DEFAULT_FILE_MODE);
-    if (out < 0) {
-        fprintf(stderr, "open dest failure: %s\n", dest);
-        close(in);
+    if ((dir = fdopendir(sfd)) == NULL) {
+        perror("fdopendir");
+        close(sfd);
+        close(dfd);
         return -1;
     }
+    while (ret == 0 && (dirp = readdir(dir)) != NULL) {
+        const char *name = dirp->d_name;
+        size_t s_saved, d_saved;
+        int type;
 
-    while ((n = read(in, buf, BUFFSIZE)) > 0) {
-        if (write(out, buf, n) != n) {
-            perror("write");
-            close(in);
-            close(out);
-            return -1;
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue; /* ignore dot and dot-dot */
+
+#ifdef XCOPY_IO_URING
+        if (uring_batch) {
+            if (dirp->d_type == DT_REG) {
+                ret = uring_batch_add(uring_batch, dirfd(dir), dfd, name, sp,
+                                      dp);
+                continue;
+            }
+            /* 배치는 이 디렉터리 fd 를 참조하므로 내려가기 전에 비움 */
+            if (dirp->d_type != DT_LNK &&
+                (ret = uring_batch_flush(uring_batch, sp, dp)) != 0)
+                break;
+        }
+#endif
+        if (path_push(sp, name, &s_saved) != 0 ||
+            path_push(dp, name, &d_saved) != 0) {
+            perror("path_push");
+            ret = -1;
+            break;
+        }
+
+        if ((type = dirent_type(dirfd(dir), dirp)) < 0) {
+            perror("fstatat");
+            ret = -1;
+        } else if (type == DT_LNK) {
+            print_skip_symlink_message(sp->buf);
+        } else if (type == DT_DIR) {
+            int child_sfd, child_dfd;
+
+            /* ensure directory on dest side */
+            if (ensure_dir_at(dfd, name, DEFAULT_DIRECTORY_MODE) != 0) {
+                fprintf(stderr, "safe_mkdir error: %s\n", dp->buf);
+                ret = -1;
+            } else if ((child_sfd = open_dir_at(dirfd(dir), name)) < 0) {
+                perror("open src dir");
+                ret = -1;
+            } else if ((child_dfd = open_dir_at(dfd, name)) < 0) {
+                perror("open dest dir");
+                close(child_sfd);
+                ret = -1;
+            } else {
+                /* recursive call */
+                ret = copy_dir_fd(child_sfd, child_dfd, sp, dp,
+                                  (preserve_mask & PRESERVE_ATTRS) != 0);
+            }
+        } else if (type == DT_REG) {
+            /* copy file */
+            ret = copy_file_at(dirfd(dir), name, dfd, name, sp->buf, dp->buf);
         }
+        path_pop(sp, s_saved);
+        path_pop(dp, d_saved);
     }
-    if (n < 0) {
-        perror("read");
-        close(in);
-        close(out);
-        return -1;
+
+#ifdef XCOPY_IO_URING
+    if (uring_batch && uring_batch_flush(uring_batch, sp, dp) != 0) ret = -1;
+#endif
+    if (ret == 0 && preserve_self)
+        ret = preserve_attributes(dirfd(dir), dfd, &st_dir, dp->buf);
+    if (closedir(dir) < 0) {
+        perror("closedir");
+        ret = -1;
     }
+    close(dfd);
+    return ret;
+}
 
-    if (close(in) < 0) perror("close src");
-    if (close(out) < 0) {
-        perror("close dst");
+int copy_directory_recursive(const char *src, const char *dest) {
+    struct path_buf sp = {0}, dp = {0};
+    int sfd, dfd, ret;
+
+    if ((sfd = open_dir_at(AT_FDCWD, src)) < 0) {
+        if (errno == ENOTDIR || errno == ELOOP)
+            fprintf(stderr, "recurv: %s is not a directory\n", src);
+        else
+            perror("open src");
+        return -1;
+    }
+    if ((dfd = open_dir_at(AT_FDCWD, dest)) < 0) {
+        perror("open dest");
+        close(sfd);
         return -1;
     }
+    if (path_set(&sp, src) != 0 || path_set(&dp, dest) != 0) {
+        perror("path_set");
+        path_free(&sp);
+        close(sfd);
+        close(dfd);
+        return -1;
+    }
+
+#ifdef XCOPY_IO_URING
+    uring_batch = uring_batch_new();
+#endif
+    /* 최상위 TARGET 디렉터리 자체의 속성은 건드리지 않습니다. (기존 -p 동작) */
+    ret = copy_dir_fd(sfd, dfd, &sp, &dp, false);
+#ifdef XCOPY_IO_URING
+    uring_batch_free(uring_batch);
+    uring_batch = NULL;
+#endif
+    path_free(&sp);
+    path_free(&dp);
+    return ret;
+}
+
+/*
+ * 병렬 복사 엔진 (-j N)
+ *
+ * 디렉터리 하나를 읽는 일과 파일 하나를 복사하는 일을 각각 작업(task)으로
+ * 보고, 작업자 스레드마다 하나씩 있는 덱(deque)에 넣습니다.
+ * - 작업자는 자기 덱의 bottom 에서 push/pop 합니다. (LIFO → 깊이 우선,
+ *   캐시 지역성 유지)
+ * - 자기 덱이 비면 다른 작업자 덱의 top 에서 가장 오래된 작업을 훔쳐옵니다.
+ *   오래된 작업일수록 트리의 위쪽이라 한 번 훔쳐도 일감이 큽니다.
+ * - pending 은 "넣었지만 아직 끝나지 않은 작업 수" 입니다. 0 이 되면 트리
+ *   전체 복사가 끝난 것이므로 모든 작업자가 종료합니다.
+ * - 한 작업이라도 실패하면 failed 를 세우고, 이후 작업은 실행하지 않고
+ *   버리기만 합니다. (단일 스레드 경로가 첫 에러에서 멈추는 것과 같은 의미)
+ * - --from-manifest 의 SOURCE/TARGET 쌍도 TASK_PAIR 작업으로 같은 풀에
+ *   넣습니다. 쌍이 디렉터리면 그 아래 작업들도 같은 풀에서 처리됩니다.
+ */
+enum copy_task_kind {
+    TASK_DIR,
+    TASK_FILE,
+    TASK_PAIR, /* 매니페스트 한 줄, parent 없음 */
+};
+
+/*
+ * 복사 중인 디렉터리 하나. src/dest 디렉터리 fd 를 열어 두고 하위 항목은
+ * 모두 이 fd 기준(openat)으로 엽니다. 이 디렉터리를 부모로 가진 작업이
+ * 모두 끝나 refs 가 0 이 되면 fd 를 닫습니다.
+ */
+struct dir_node {
+    DIR *src_dir; /* readdir 용 스트림, src_fd 는 dirfd(src_dir) */
+    int src_fd;
+    int dst_fd;
+    atomic_int refs;
+    char *src_path; /* 메시지용 전체 경로 */
+    char *dst_path;
+    bool preserve_self; /* 마지막 참조가 풀릴 때 디렉터리 속성을 맞춤 */
+    struct stat src_st;
+};
+
+struct copy_task {
+    enum copy_task_kind kind;
+    struct dir_node *parent;
+    char name[]; /* parent 디렉터리 안에서의 이름, TASK_PAIR 면 "SRC\0DST" */
+};
+
+struct task_deque {
+    pthread_mutex_t lock;
+    struct copy_task **buf; /* 원형 버퍼, cap 은 항상 2의 거듭제곱 */
+    size_t cap;
+    size_t top;    /* 도둑이 가져가는 쪽 */
+    size_t bottom; /* 주인이 넣고 빼는 쪽 */
+};
+
+struct copy_pool {
+    int nworkers;
+    struct task_deque *deques;
+    atomic_long pending;
+    atomic_bool failed;
+    atomic_int sleepers;
+    pthread_mutex_t idle_lock;
+    pthread_cond_t idle_cond;
+};
+
+struct copy_worker {
+    struct copy_pool *pool;
+    int id;
+    unsigned int seed; /* 훔칠 대상 선택용 xorshift 상태 */
+    pthread_t tid;
+    struct path_buf sp, dp; /* 메시지용 경로 버퍼 (작업자마다 하나) */
+};
+
+/* 풀 작업자로 일하는 중인 스레드면 자기 작업자, 아니면 NULL */
+static _Thread_local struct copy_worker *pool_self;
+
+static int task_deque_init(struct task_deque *dq) {
+    dq->buf = malloc(sizeof(*dq->buf) * TASK_DEQUE_INIT_CAP);
+    if (!dq->buf) return -1;
+    dq->cap = TASK_DEQUE_INIT_CAP;
+    dq->top = dq->bottom = 0;
+    pthread_mutex_init(&dq->lock, NULL);
+    return 0;
+}
+static void task_deque_destroy(struct task_deque *dq) {
+    pthread_mutex_destroy(&dq->lock);
+    free(dq->buf);
+}
+static bool task_deque_empty(struct task_deque *dq) {
+    bool empty;
+    pthread_mutex_lock(&dq->lock);
+    empty = (dq->top == dq->bottom);
+    pthread_mutex_unlock(&dq->lock);
+    return empty;
+}
+static int task_deque_push(struct task_deque *dq, struct copy_task *t) {
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom - dq->top == dq->cap) {
+        /* 가득 찼으면 두 배로 늘리면서 top 부터 순서대로 다시 배치 */
+        size_t n = dq->bottom - dq->top;
+        struct copy_task **nbuf = malloc(sizeof(*nbuf) * dq->cap * 2);
+        if (!nbuf) {
+            pthread_mutex_unlock(&dq->lock);
+            return -1;
+        }
+        for (size_t i = 0; i < n; i++)
+            nbuf[i] = dq->buf[(dq->top + i) & (dq->cap - 1)];
+        free(dq->buf);
+        dq->buf = nbuf;
+        dq->cap *= 2;
+        dq->top = 0;
+        dq->bottom = n;
+    }
+    dq->buf[dq->bottom & (dq->cap - 1)] = t;
+    dq->bottom++;
+    pthread_mutex_unlock(&dq->lock);
     return 0;
 }
-int preserve_file_attributes(const char *src, const char *dest) {
-    struct stat stat_buf;
-    if (stat(src, &stat_buf) != 0) {
-        perror("stat");
-        return -1;
+static struct copy_task *task_deque_pop(struct task_deque *dq) {
+    struct copy_task *t = NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom != dq->top) {
+        dq->bottom--;
+        t = dq->buf[dq->bottom & (dq->cap - 1)];
     }
+    pthread_mutex_unlock(&dq->lock);
+    return t;
+}
+static struct copy_task *task_deque_steal(struct task_deque *dq) {
+    struct copy_task *t = NULL;
+    pthread_mutex_lock(&dq->lock);
+    if (dq->bottom != dq->top) {
+        t = dq->buf[dq->top & (dq->cap - 1)];
+        dq->top++;
+    }
+    pthread_mutex_unlock(&dq->lock);
+    return t;
+}
 
-    if (chmod(dest, stat_buf.st_mode) != 0) {
-        perror("chmod");
-        return -1;
+// 열린 src/dest 디렉터리 fd 로 dir_node 를 만듭니다. 성공하면 두 fd 와
+// 경로 문자열의 소유권은 노드로 넘어갑니다.
+static struct dir_node *dir_node_new(int sfd, int dfd, char *src_path,
+                                     char *dst_path) {
+    struct dir_node *node = malloc(sizeof(*node));
+    if (!node) return NULL;
+    if ((node->src_dir = fdopendir(sfd)) == NULL) {
+        free(node);
+        return NULL;
     }
+    node->src_fd = sfd;
+    node->dst_fd = dfd;
+    node->src_path = src_path;
+    node->dst_path = dst_path;
+    node->preserve_self = false;
+    atomic_init(&node->refs, 1); /* 디렉터리를 읽는 쪽의 참조 */
+    return node;
+}
+
+// 참조를 하나 내려놓습니다. 마지막 참조였다면 하위 작업이 모두 끝난
+// 것이므로 (-p 일 때) 디렉터리 속성을 맞추고 fd 를 닫습니다.
+static int dir_node_put(struct dir_node *node) {
+    int ret = 0;
+
+    if (atomic_fetch_sub(&node->refs, 1) != 1) return 0;
+    if (node->preserve_self)
+        ret = preserve_attributes(node->src_fd, node->dst_fd, &node->src_st,
+                                  node->dst_path);
+    closedir(node->src_dir);
+    close(node->dst_fd);
+    free(node->src_path);
+    free(node->dst_path);
+    free(node);
+    return ret;
+}
+
+// 작업을 자기 덱에 넣습니다. 작업은 parent 에 대한 참조를 하나 가집니다.
+// TASK_PAIR 는 parent 가 NULL 이고 name 에 "SRC\0DST" 가 len 바이트 들어옵니다.
+static int pool_push(struct copy_worker *w, enum copy_task_kind kind,
+                     struct dir_node *parent, const char *name, size_t len) {
+    struct copy_pool *pool = w->pool;
+    struct copy_task *t = malloc(sizeof(*t) + len);
+    if (!t) return -1;
+    t->kind = kind;
+    t->parent = parent;
+    memcpy(t->name, name, len);
 
-    struct timespec times[2];
-    times[0] = stat_buf.st_atim;
-    times[1] = stat_buf.st_mtim;
-    if (utimensat(AT_FDCWD, dest, times, 0) != 0) {
-        perror("utimensat");
+    if (parent) atomic_fetch_add(&parent->refs, 1);
+    atomic_fetch_add(&pool->pending, 1);
+    if (task_deque_push(&pool->deques[w->id], t) != 0) {
+        atomic_fetch_sub(&pool->pending, 1);
+        if (parent) atomic_fetch_sub(&parent->refs, 1);
+        free(t);
         return -1;
     }
-
+    /* 잠든 작업자가 있을 때만 깨웁니다. (대부분의 push 는 락 없이 끝남) */
+    if (atomic_load(&pool->sleepers) > 0) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_signal(&pool->idle_cond);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
     return 0;
 }
-int process_preserve(const char *src, const char *dest) {
-    struct stat st;
 
-    if (lstat(src, &st) != 0) {
-        perror("lstat");
+static int pool_submit(struct copy_worker *w, enum copy_task_kind kind,
+                       struct dir_node *parent, const char *name) {
+    return pool_push(w, kind, parent, name, strlen(name) + 1);
+}
+
+// 작업 하나가 끝났음을 알립니다. 마지막 작업이었다면 모두 깨워 종료시킵니다.
+static void pool_task_done(struct copy_pool *pool) {
+    if (atomic_fetch_sub(&pool->pending, 1) == 1) {
+        pthread_mutex_lock(&pool->idle_lock);
+        pthread_cond_broadcast(&pool->idle_cond);
+        pthread_mutex_unlock(&pool->idle_lock);
+    }
+}
+
+// 작업자의 메시지용 경로 버퍼에 parent 경로 + "/" + name 을 채웁니다.
+static int worker_set_paths(struct copy_worker *w, struct dir_node *parent,
+                            const char *name) {
+    size_t saved;
+    if (path_set(&w->sp, parent->src_path) != 0 ||
+        path_set(&w->dp, parent->dst_path) != 0 ||
+        path_push(&w->sp, name, &saved) != 0 ||
+        path_push(&w->dp, name, &saved) != 0) {
+        perror("path_push");
         return -1;
     }
+    return 0;
+}
 
-    if (S_ISLNK(st.st_mode)) {
-        /* preserve시 심볼릭 링크 무시 출력문 스킵 */
-        // print_skip_symlink_message(src);
-    } else if (S_ISDIR(st.st_mode)) {
-        DIR *dp;
-        struct dirent *dirp;
-        if ((dp = opendir(src)) == NULL) {
-            perror("opendir");
-            return -1;
-        }
+// 디렉터리 하나를 읽어 하위 디렉터리는 TASK_DIR, 파일은 TASK_FILE 로 넣습니다.
+// 하위 디렉터리는 작업을 넣기 전에 dest 쪽에 먼저 만들어 둡니다.
+static int run_dir_scan(struct copy_worker *w, struct dir_node *node) {
+    struct dirent *dirp;
 
-        while ((dirp = readdir(dp)) != NULL) {
-            struct stat child_st;
+    while ((dirp = readdir(node->src_dir)) != NULL) {
+        const char *name = dirp->d_name;
+        int type;
 
-            if (strcmp(dirp->d_name, ".") == 0 ||
-                strcmp(dirp->d_name, "..") == 0)
-                continue;
+        if (atomic_load(&w->pool->failed)) break; /* 다른 작업자가 실패함 */
+        if (strcmp(name, ".") == 0 || strcmp(name, "..") == 0)
+            continue; /* ignore dot and dot-dot */
 
-            // 동적 경로 버퍼 할당 함수 사용
-            char *child_src = concat_path(src, dirp->d_name);
-            char *child_dest = concat_path(dest, dirp->d_name);
-            if (!child_src || !child_dest) {
-                perror("alloc_path_concat");
-                if (child_src) free(child_src);
-                if (child_dest) free(child_dest);
-                closedir(dp);
+        if ((type = dirent_type(node->src_fd, dirp)) < 0) {
+            perror("fstatat");
+            return -1;
+        } else if (type == DT_LNK) {
+            if (worker_set_paths(w, node, name) != 0) return -1;
+            print_skip_symlink_message(w->sp.buf);
+        } else if (type == DT_DIR) {
+            if (ensure_dir_at(node->dst_fd, name, DEFAULT_DIRECTORY_MODE) !=
+                0) {
+                if (worker_set_paths(w, node, name) == 0)
+                    fprintf(stderr, "safe_mkdir error: %s\n", w->dp.buf);
                 return -1;
             }
-
-            if (lstat(child_src, &child_st) != 0) {
-                perror("lstat");
-                free(child_src);
-                free(child_dest);
-                closedir(dp);
+            if (pool_submit(w, TASK_DIR, node, name) != 0) {
+                perror("pool_submit");
                 return -1;
             }
-
-            if (S_ISLNK(child_st.st_mode)) {
-                /* preserve시 심볼릭 링크 무시 출력문 스킵 */
-                // print_skip_symlink_message(child_src);
-                continue;
-            } else if (S_ISDIR(child_st.st_mode)) {
-                /* 현재 entry가 디렉터리인 경우 */
-
-                /* 먼저 디렉터리 속성 보존 */
-                if (preserve_file_attributes(child_src, child_dest) != 0) {
-                    free(child_src);
-                    free(child_dest);
-                    closedir(dp);
-                    return -1;
-                }
-                /* 재귀 호출로 넘어갑니다. */
-                if (process_preserve(child_src, child_dest) != 0) {
-                    free(child_src);
-                    free(child_dest);
-                    closedir(dp);
-                    return -1;
-                }
-            } else if (S_ISREG(child_st.st_mode)) {
-                /* 현재 entry가 일반 파일인 경우 */
-                if (preserve_file_attributes(child_src, child_dest) != 0) {
-                    free(child_src);
-                    free(child_dest);
-                    closedir(dp);
-                    return -1;
-                }
+        } else if (type == DT_REG) {
+            if (pool_submit(w, TASK_FILE, node, name) != 0) {
+                perror("pool_submit");
+                return -1;
             }
-            /* 나머지 파일 종류는 무시합니다. */
-            free(child_src);
-            free(child_dest);
-        }
-        closedir(dp);
-    } else if (S_ISREG(st.st_mode)) { /* 현재 디렉터리가 아니라 일반 파일이면,
-                                         바로 속성을 보존합니다. */
-        if (preserve_file_attributes(src, dest) != 0) {
-            fprintf(stderr, "Failed to preserve attributes for %s\n", src);
-            return -1;
         }
-    } else { /* 일반 파일도 아니고 디렉터리도 아닌 경우*/
-        fprintf(stderr, "Unsupported file type for %s\n", src);
+    }
+    return 0;
+}
+
+// parent 아래의 하위 디렉터리 name 을 열어 노드로 만들고 읽습니다.
+static int run_dir_task(struct copy_worker *w, struct dir_node *parent,
+                        const char *name) {
+    struct dir_node *node;
+    char *src_path, *dst_path;
+    int sfd, dfd, ret;
+
+    if ((sfd = open_dir_at(parent->src_fd, name)) < 0) {
+        perror("open src dir");
+        return -1;
+    }
+    if ((dfd = open_dir_at(parent->dst_fd, name)) < 0) {
+        perror("open dest dir");
+        close(sfd);
         return -1;
     }
+    /* 경로 문자열은 파일마다가 아니라 디렉터리마다 한 번만 만듭니다. */
+    src_path = concat_path(parent->src_path, name);
+    dst_path = concat_path(parent->dst_path, name);
+    if (!src_path || !dst_path ||
+        (node = dir_node_new(sfd, dfd, src_path, dst_path)) == NULL) {
+        perror("dir_node_new");
+        free(src_path);
+        free(dst_path);
+        close(sfd);
+        close(dfd);
+        return -1;
+    }
+    if (preserve_mask & PRESERVE_ATTRS) {
+        if (fstat(node->src_fd, &node->src_st) != 0) {
+            perror("fstat src dir");
+            dir_node_put(node);
+            return -1;
+        }
+        node->preserve_self = true;
+    }
 
-    return 0;
+    ret = run_dir_scan(w, node);
+    if (dir_node_put(node) != 0) ret = -1;
+    return ret;
 }
 
-bool file_exists(const char *path) {
-    if (access(path, F_OK) == 0) {
-        return true;
-    } else {
-        return false;
+static int run_file_task(struct copy_worker *w, struct dir_node *parent,
+                         const char *name) {
+    if (worker_set_paths(w, parent, name) != 0) return -1;
+    return copy_file_at(parent->src_fd, name, parent->dst_fd, name,
+                        w->sp.buf, w->dp.buf);
+}
+
+// src, dest 디렉터리를 열어 트리의 루트 노드를 만듭니다.
+// 루트(TARGET) 디렉터리 자체의 속성은 보존하지 않습니다. (기존 -p 동작)
+static struct dir_node *dir_node_open_root(const char *src, const char *dest) {
+    struct dir_node *root;
+    char *root_src, *root_dest;
+    int sfd, dfd;
+
+    if ((sfd = open_dir_at(AT_FDCWD, src)) < 0) {
+        if (errno == ENOTDIR || errno == ELOOP)
+            fprintf(stderr, "recurv: %s is not a directory\n", src);
+        else
+            perror("open src");
+        return NULL;
+    }
+    if ((dfd = open_dir_at(AT_FDCWD, dest)) < 0) {
+        perror("open dest");
+        close(sfd);
+        return NULL;
+    }
+    root_src = strdup(src);
+    root_dest = strdup(dest);
+    if (!root_src || !root_dest ||
+        (root = dir_node_new(sfd, dfd, root_src, root_dest)) == NULL) {
+        perror("dir_node_new");
+        free(root_src);
+        free(root_dest);
+        close(sfd);
+        close(dfd);
+        return NULL;
+    }
+    return root;
+}
+
+// 이미 돌고 있는 풀 안에서 (매니페스트의 디렉터리 쌍) src 아래를 읽어
+// 작업으로 넣습니다. 하위 작업들이 끝나기를 기다리지 않고 돌아옵니다.
+static int copy_directory_in_pool(struct copy_worker *w, const char *src,
+                                  const char *dest) {
+    struct dir_node *root = dir_node_open_root(src, dest);
+    int ret;
+
+    if (!root) return -1;
+    ret = run_dir_scan(w, root);
+    if (dir_node_put(root) != 0) ret = -1;
+    return ret;
+}
+
+// 자기 덱 → 다른 작업자 덱 순서로 작업을 찾습니다.
+static struct copy_task *pool_find_task(struct copy_worker *w) {
+    struct copy_pool *pool = w->pool;
+    struct copy_task *t = task_deque_pop(&pool->deques[w->id]);
+    if (t) return t;
+
+    /* 매번 같은 희생자에게 몰리지 않도록 시작 위치를 무작위로 고름 */
+    w->seed ^= w->seed << 13;
+    w->seed ^= w->seed >> 17;
+    w->seed ^= w->seed << 5;
+    int start = (int)(w->seed % (unsigned int)pool->nworkers);
+    for (int i = 0; i < pool->nworkers; i++) {
+        int victim = (start + i) % pool->nworkers;
+        if (victim == w->id) continue;
+        if ((t = task_deque_steal(&pool->deques[victim])) != NULL) return t;
+    }
+    return NULL;
+}
+
+static bool pool_has_work(struct copy_pool *pool) {
+    for (int i = 0; i < pool->nworkers; i++)
+        if (!task_deque_empty(&pool->deques[i])) return true;
+    return false;
+}
+
+static void *copy_worker_main(void *arg) {
+    struct copy_worker *w = arg;
+    struct copy_pool *pool = w->pool;
+
+    pool_self = w;
+    for (;;) {
+        struct copy_task *t = pool_find_task(w);
+        if (!t) {
+            /*
+             * 훔칠 것도 없으면 잠듭니다. sleepers 를 먼저 올리고 idle_lock
+             * 안에서 다시 확인하므로, 그 사이에 들어온 push 의 signal 을
+             * 놓치지 않습니다.
+             */
+            pthread_mutex_lock(&pool->idle_lock);
+            atomic_fetch_add(&pool->sleepers, 1);
+            while (atomic_load(&pool->pending) > 0 && !pool_has_work(pool))
+                pthread_cond_wait(&pool->idle_cond, &pool->idle_lock);
+            atomic_fetch_sub(&pool->sleepers, 1);
+            pthread_mutex_unlock(&pool->idle_lock);
+            if (atomic_load(&pool->pending) == 0) break;
+            continue;
+        }
+
+        if (!atomic_load(&pool->failed)) {
+            int ret;
+            if (t->kind == TASK_DIR)
+                ret = run_dir_task(w, t->parent, t->name);
+            else if (t->kind == TASK_FILE)
+                ret = run_file_task(w, t->parent, t->name);
+            else
+                ret = copy_manifest_pair(t->name,
+                                         t->name + strlen(t->name) + 1);
+            if (ret != 0) atomic_store(&pool->failed, true);
+        }
+        if (t->parent && dir_node_put(t->parent) != 0)
+            atomic_store(&pool->failed, true);
+        free(t);
+        pool_task_done(pool);
+    }
+    pool_self = NULL;
+    return NULL;
+}
+
+// nworkers 개 작업자의 풀을 준비합니다. 0번 작업자는 호출한 스레드 몫
+// 이고, pending 은 1 로 잡아 둡니다. (호출한 쪽이 첫 작업들을 넣는 동안
+// 다른 작업자가 "할 일 없음" 으로 끝나지 않도록. 다 넣으면 pool_task_done)
+static struct copy_worker *pool_init(struct copy_pool *pool, int nworkers) {
+    struct copy_worker *workers;
+    int i;
+
+    pool->nworkers = nworkers;
+    atomic_init(&pool->pending, 1);
+    atomic_init(&pool->failed, false);
+    atomic_init(&pool->sleepers, 0);
+    pool->deques = calloc(nworkers, sizeof(*pool->deques));
+    workers = calloc(nworkers, sizeof(*workers));
+    if (!pool->deques || !workers) {
+        perror("calloc");
+        free(pool->deques);
+        free(workers);
+        return NULL;
+    }
+    for (i = 0; i < nworkers; i++) {
+        if (task_deque_init(&pool->deques[i]) != 0) {
+            perror("task_deque_init");
+            while (--i >= 0) task_deque_destroy(&pool->deques[i]);
+            free(pool->deques);
+            free(workers);
+            return NULL;
+        }
+        workers[i].pool = pool;
+        workers[i].id = i;
+        workers[i].seed = 2463534242u + (unsigned int)i * 7919u;
+    }
+    pthread_mutex_init(&pool->idle_lock, NULL);
+    pthread_cond_init(&pool->idle_cond, NULL);
+    return workers;
+}
+
+// 1..nworkers-1 번 작업자 스레드를 띄웁니다. 실제로 시작된 작업자 수
+// (0번 포함)를 돌려줍니다.
+static int pool_start(struct copy_pool *pool, struct copy_worker *workers) {
+    int i, started = 1;
+
+    for (i = 1; i < pool->nworkers; i++) {
+        if (pthread_create(&workers[i].tid, NULL, copy_worker_main,
+                           &workers[i]) != 0) {
+            /* 스레드를 더 못 만들면 있는 작업자들로만 진행 */
+            fprintf(stderr, "pthread_create failed, using %d workers\n", i);
+            break;
+        }
+        started++;
+    }
+    return started;
+}
+
+// 첫 작업을 다 넣은 뒤 부릅니다. 현재 스레드도 0번 작업자로 일하다가
+// 모든 작업이 끝나면 스레드를 거두고 풀을 정리합니다. 실패가 있었으면 -1
+static int pool_finish(struct copy_pool *pool, struct copy_worker *workers,
+                       int started) {
+    int i, ret = 0;
+
+    pool_task_done(pool);
+    copy_worker_main(&workers[0]);
+    for (i = 1; i < started; i++) pthread_join(workers[i].tid, NULL);
+
+    if (atomic_load(&pool->failed)) ret = -1;
+    for (i = 0; i < pool->nworkers; i++) {
+        task_deque_destroy(&pool->deques[i]);
+        path_free(&workers[i].sp);
+        path_free(&workers[i].dp);
+    }
+    pthread_mutex_destroy(&pool->idle_lock);
+    pthread_cond_destroy(&pool->idle_cond);
+    free(pool->deques);
+    free(workers);
+    return ret;
+}
+
+// src 디렉터리 아래를 nworkers 개의 스레드로 dest 에 복사합니다.
+// dest 디렉터리는 호출 전에 이미 존재해야 합니다. (copy_directory_recursive 와 동일)
+int copy_directory_parallel(const char *src, const char *dest, int nworkers) {
+    struct copy_pool pool;
+    struct copy_worker *workers;
+    struct dir_node *root;
+    int started;
+
+    if ((root = dir_node_open_root(src, dest)) == NULL) return -1;
+    if ((workers = pool_init(&pool, nworkers)) == NULL) {
+        dir_node_put(root);
+        return -1;
+    }
+    started = pool_start(&pool, workers);
+
+    /* 루트 디렉터리는 현재 스레드가 0번 작업자로서 직접 읽습니다. */
+    if (run_dir_scan(&workers[0], root) != 0) atomic_store(&pool.failed, true);
+    if (dir_node_put(root) != 0) atomic_store(&pool.failed, true);
+    return pool_finish(&pool, workers, started);
+}
+
+// -j 옵션에 따라 디렉터리 트리 복사 경로를 고릅니다.
+// jobs_opt == 1 이면 기존 단일 스레드 재귀 복사, 그 이상이면 병렬 복사 엔진.
+// 이미 풀 작업자 안(--from-manifest -j N)이면 그 풀에 작업을 넣습니다.
+int copy_directory_tree(const char *src, const char *dest) {
+    if (pool_self) return copy_directory_in_pool(pool_self, src, dest);
+    if (jobs_opt > 1) return copy_directory_parallel(src, dest, jobs_opt);
+    return copy_directory_recursive(src, dest);
+}
+
+/*
+ * --from-manifest: 한 프로세스로 여러 SOURCE/TARGET 쌍을 복사
+ *
+ * 매니페스트는 한 줄에 "SOURCE<TAB>TARGET" 하나입니다. 빈 줄과 '#' 으로
+ * 시작하는 줄은 무시합니다. 각 쌍은 명령행으로 하나씩 준 것과 같이
+ * copy_entry 로 처리하되, TARGET 의 상위 디렉터리가 없으면 만듭니다.
+ * -j N 이면 매니페스트를 읽으면서 쌍을 TASK_PAIR 로 풀에 넣으므로, 쌍들과
+ * 그 아래 디렉터리 트리들이 모두 하나의 작업자 풀을 나눠 씁니다.
+ * 트리 복사와 같이 첫 실패에서 멈춥니다.
+ */
+int copy_manifest_pair(const char *src, const char *dest) {
+    const char *slash = strrchr(dest, '/');
+
+    if (slash && slash != dest) {
+        size_t len = (size_t)(slash - dest);
+        char *parent = malloc(len + 1);
+        if (!parent) {
+            perror("malloc");
+            return -1;
+        }
+        memcpy(parent, dest, len);
+        parent[len] = '\0';
+        if (mkdirs(parent) != 0) {
+            fprintf(stderr, "mkdirs error: %s\n", parent);
+            free(parent);
+            return -1;
+        }
+        free(parent);
+    }
+    if (copy_entry(src, dest) != 0) {
+        fprintf(stderr, "manifest entry failed: %s -> %s\n", src, dest);
+        return -1;
+    }
+    return 0;
+}
+
+// 매니페스트에서 다음 쌍을 읽습니다. 1: 읽음, 0: 끝, -1: 형식 에러
+// *line 은 getline 버퍼이고, *src/*dest 는 그 안을 가리킵니다.
+static int manifest_next(FILE *fp, const char *path, char **line, size_t *cap,
+                         long *lineno, char **src, char **dest) {
+    ssize_t n;
+
+    while ((n = getline(line, cap, fp)) >= 0) {
+        char *tab;
+
+        (*lineno)++;
+        while (n > 0 && ((*line)[n - 1] == '\n' || (*line)[n - 1] == '\r'))
+            (*line)[--n] = '\0';
+        if (n == 0 || (*line)[0] == '#') continue;
+        if ((tab = strchr(*line, '\t')) == NULL || tab == *line ||
+            tab[1] == '\0') {
+            fprintf(stderr, "%s:%ld: expected SOURCE<TAB>TARGET\n", path,
+                    *lineno);
+            return -1;
+        }
+        *tab = '\0';
+        *src = *line;
+        *dest = tab + 1;
+        return 1;
+    }
+    if (ferror(fp)) {
+        perror("read manifest");
+        return -1;
+    }
+    return 0;
+}
+
+// path 의 매니페스트("-" 면 stdin)에 적힌 쌍들을 모두 복사합니다.
+int copy_manifest(const char *path) {
+    FILE *fp = strcmp(path, "-") == 0 ? stdin : fopen(path, "r");
+    char *line = NULL, *src, *dest;
+    size_t cap = 0;
+    long lineno = 0;
+    int r = 0, ret = 0;
+
+    if (!fp) {
+        perror("open manifest");
+        return -1;
+    }
+    if (jobs_opt == 1) {
+        while ((r = manifest_next(fp, path, &line, &cap, &lineno, &src,
+                                  &dest)) > 0) {
+            if (copy_manifest_pair(src, dest) != 0) {
+                ret = -1;
+                break;
+            }
+        }
+        if (r < 0) ret = -1;
+    } else {
+        struct copy_pool pool;
+        struct copy_worker *workers = pool_init(&pool, jobs_opt);
+        int started;
+
+        if (!workers) {
+            ret = -1;
+            goto out;
+        }
+        started = pool_start(&pool, workers);
+        /* 다른 작업자들이 앞쪽 쌍을 훔쳐 가는 동안 계속 읽어 넣음 */
+        while (!atomic_load(&pool.failed) &&
+               (r = manifest_next(fp, path, &line, &cap, &lineno, &src,
+                                  &dest)) > 0) {
+            /* 탭 자리가 '\0' 이 되어 line 은 이미 "SRC\0DST\0" 모양 */
+            size_t slen = strlen(src) + 1, dlen = strlen(dest) + 1;
+            if (pool_push(&workers[0], TASK_PAIR, NULL, src, slen + dlen) !=
+                0) {
+                perror("pool_push");
+                atomic_store(&pool.failed, true);
+            }
+        }
+        if (r < 0) atomic_store(&pool.failed, true);
+        ret = pool_finish(&pool, workers, started);
+    }
+out:
+    free(line);
+    if (fp != stdin) fclose(fp);
+    return ret;
+}
+
+// copy_file_once 가 --stats 용으로 알려 주는 값
+struct file_cost {
+    off_t bytes;           /* 원본 크기 */
+    unsigned long data_ns; /* copy_file_data 에 쓴 시간 */
+};
+
+/*
+ * 하드 링크 보존 (--preserve=links)
+ *
+ * 링크 수가 2 이상인 원본 파일을 (st_dev, st_ino) 로 표에 기억해 두고, 같은
+ * inode 를 다시 만나면 데이터를 복사하지 않고 처음 만든 dest 에 linkat 으로
+ * 링크를 겁니다. 링크 수가 1 인 파일은 표를 보지 않으므로 보통 트리에서는
+ * 비용이 없습니다.
+ *
+ * -j N 에서 두 작업자가 같은 inode 를 동시에 만나면 먼저 등록한 쪽이 복사를
+ * 끝낼 때까지 다른 쪽이 기다립니다. 처음 복사가 실패하면 다음에 만난 쪽이
+ * 대신 복사를 맡습니다.
+ */
+enum link_state { LINK_PENDING, LINK_READY, LINK_FAILED };
+
+struct link_entry {
+    struct link_entry *next;
+    dev_t dev;
+    ino_t ino;
+    dev_t dst_dev; /* 처음 만든 dest 의 inode (LINK_READY 일 때) */
+    ino_t dst_ino;
+    enum link_state state;
+    char *dest; /* 처음 만든 dest 경로 (AT_FDCWD 기준) */
+};
+
+struct link_table {
+    struct link_entry **buckets;
+    size_t nbuckets; /* 2의 거듭제곱 */
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+};
+
+static struct link_table links = {NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER,
+                                  PTHREAD_COND_INITIALIZER};
+
+static size_t link_hash(dev_t dev, ino_t ino) {
+    uint64_t h = ((uint64_t)dev * 31 + (uint64_t)ino) * 0x9e3779b97f4a7c15ULL;
+    return (size_t)(h >> 20);
+}
+
+// 평균 체인 길이가 1 을 넘으면 버킷 수를 두 배로 늘립니다. (lock 보유 중)
+static int link_table_grow(void) {
+    size_t n = links.nbuckets ? links.nbuckets * 2 : LINK_TABLE_INIT_SIZE;
+    struct link_entry **b = calloc(n, sizeof(*b));
+
+    if (!b) return -1;
+    for (size_t i = 0; i < links.nbuckets; i++) {
+        struct link_entry *e = links.buckets[i], *next;
+        for (; e; e = next) {
+            size_t h = link_hash(e->dev, e->ino) & (n - 1);
+            next = e->next;
+            e->next = b[h];
+            b[h] = e;
+        }
+    }
+    free(links.buckets);
+    links.buckets = b;
+    links.nbuckets = n;
+    return 0;
+}
+
+// st 의 inode 를 표에서 찾습니다. 처음 보거나 앞선 복사가 실패한 inode 면
+// dest 로 등록하고 *owner = true (호출한 쪽이 복사한 뒤 link_finish 호출).
+// 이미 복사된 inode 면 *owner = false 로 그 항목을 돌려줍니다.
+// 메모리가 없으면 NULL (그냥 복사하면 됨)
+static struct link_entry *link_claim(const struct stat *st, const char *dest,
+                                     bool *owner) {
+    struct link_entry *e;
+    char *copy = strdup(dest);
+
+    if (!copy) return NULL;
+    pthread_mutex_lock(&links.lock);
+    if (links.count >= links.nbuckets && link_table_grow() != 0 &&
+        links.nbuckets == 0) {
+        pthread_mutex_unlock(&links.lock);
+        free(copy);
+        return NULL;
+    }
+    size_t h = link_hash(st->st_dev, st->st_ino) & (links.nbuckets - 1);
+    for (e = links.buckets[h]; e; e = e->next)
+        if (e->dev == st->st_dev && e->ino == st->st_ino) break;
+
+    if (e) {
+        while (e->state == LINK_PENDING)
+            pthread_cond_wait(&links.cond, &links.lock);
+        if (e->state == LINK_READY) {
+            pthread_mutex_unlock(&links.lock);
+            free(copy);
+            *owner = false;
+            return e;
+        }
+        free(e->dest); /* LINK_FAILED: 이번 dest 로 다시 시도 */
+    } else if ((e = malloc(sizeof(*e))) == NULL) {
+        pthread_mutex_unlock(&links.lock);
+        free(copy);
+        return NULL;
+    } else {
+        e->dev = st->st_dev;
+        e->ino = st->st_ino;
+        e->next = links.buckets[h];
+        links.buckets[h] = e;
+        links.count++;
+    }
+    e->dest = copy;
+    e->state = LINK_PENDING;
+    pthread_mutex_unlock(&links.lock);
+    *owner = true;
+    return e;
+}
+
+// link_claim 으로 맡은 복사가 끝났음을 알립니다. ok 면 dest 의 inode 를
+// 기록해 두고, 기다리던 작업자들을 깨웁니다.
+static void link_finish(struct link_entry *e, bool ok, int dst_dfd,
+                        const char *dst_name) {
+    struct stat st;
+
+    if (ok && fstatat(dst_dfd, dst_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+        ok = false;
+    pthread_mutex_lock(&links.lock);
+    if (ok) {
+        e->dst_dev = st.st_dev;
+        e->dst_ino = st.st_ino;
+    }
+    e->state = ok ? LINK_READY : LINK_FAILED;
+    pthread_cond_broadcast(&links.cond);
+    pthread_mutex_unlock(&links.lock);
+}
+
+// 이미 복사된 inode 의 dest 에 dst_dfd/dst_name 으로 링크를 겁니다.
+// 0: 링크함, 1: 이미 같은 링크 (건너뜀), -1: 실패,
+// -2: 이 위치에는 링크를 걸 수 없음 (다른 파일 시스템 등, 복사로 대신)
+static int link_to_first(const struct link_entry *e, int dst_dfd,
+                         const char *dst_name, const char *src,
+                         const char *dest) {
+    struct stat st;
+
+    if (fstatat(dst_dfd, dst_name, &st, AT_SYMLINK_NOFOLLOW) == 0) {
+        if (st.st_dev == e->dst_dev && st.st_ino == e->dst_ino) {
+            if (verbose_opt) print_unchanged_message(src, dest);
+            return 1;
+        }
+        if (!update_opt)
+            fprintf(stderr, "Warning: File '%s' already exists.\n", dest);
+        if (unlinkat(dst_dfd, dst_name, 0) != 0) {
+            perror("unlink dest");
+            return -1;
+        }
+    }
+    if (linkat(AT_FDCWD, e->dest, dst_dfd, dst_name, 0) != 0) {
+        if (errno == EXDEV || errno == EMLINK || errno == EPERM) return -2;
+        perror("linkat");
+        fprintf(stderr, "link failure: %s -> %s\n", e->dest, dest);
+        return -1;
+    }
+    if (verbose_opt) print_verbose_message(src, dest, "hard link");
+    return 0;
+}
+
+void link_table_free(void) {
+    for (size_t i = 0; i < links.nbuckets; i++) {
+        struct link_entry *e = links.buckets[i], *next;
+        for (; e; e = next) {
+            next = e->next;
+            free(e->dest);
+            free(e);
+        }
+    }
+    free(links.buckets);
+    links.buckets = NULL;
+    links.nbuckets = links.count = 0;
+}
+
+// 열어 둔 원본 in 을 dst_dfd/dst_name 으로 복사하고 in 을 닫습니다.
+// 0: 복사함, 1: --update 로 건너뜀, -1: 실패
+static int copy_opened_file(int in, const struct stat *st_in_p, int dst_dfd,
+                            const char *dst_name, const char *src,
+                            const char *dest, struct file_cost *cost) {
+    int out;
+    struct stat st_in = *st_in_p, st_out;
+    const char *how = NULL;
+    char how_buf[64];
+    int wr_flag = verify_opt ? O_RDWR : O_WRONLY; /* --verify 는 다시 읽음 */
+
+    if (update_opt) {
+        int r = dest_is_up_to_date(in, &st_in, dst_dfd, dst_name);
+        if (r > 0 && (preserve_mask & PRESERVE_ATTRS)) {
+            /* 내용이 같아도 권한/시간 등은 원본에 맞춰 둡니다. */
+            int fd = openat(dst_dfd, dst_name, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) {
+                perror("open dest");
+                r = -1;
+            } else {
+                if (preserve_attributes(in, fd, &st_in, dest) != 0) r = -1;
+                close(fd);
+            }
+        }
+        if (r != 0) {
+            close(in);
+            if (r > 0 && verbose_opt) print_unchanged_message(src, dest);
+            return r;
+        }
+        out = openat(dst_dfd, dst_name,
+                     wr_flag | O_CREAT | O_TRUNC | O_CLOEXEC,
+                     DEFAULT_FILE_MODE);
+    } else {
+        /*
+         * 보통은 dest 가 없으므로 O_EXCL 로 바로 만들어 보고, 이미 있을 때만
+         * 경고를 찍고 덮어씁니다. (존재 확인용 시스템 콜을 따로 부르지 않음)
+         */
+        out = openat(dst_dfd, dst_name, wr_flag | O_CREAT | O_EXCL | O_CLOEXEC,
+                     DEFAULT_FILE_MODE);
+        if (out < 0 && errno == EEXIST) {
+            /* Check if destination file exists and print warning */
+            fprintf(stderr, "Warning: File '%s' already exists.\n", dest);
+            out = openat(dst_dfd, dst_name, wr_flag | O_TRUNC | O_CLOEXEC);
+        }
+    }
+    if (out < 0) {
+        fprintf(stderr, "open dest failure: %s\n", dest);
+        close(in);
+        return -1;
+    }
+    if (fstat(out, &st_out) != 0) {
+        perror("fstat dst");
+        close(in);
+        close(out);
+        return -1;
+    }
+
+    unsigned long t0 = stats_clock();
+    verify_begin();
+    int r = copy_file_data(in, out, &st_in, &st_out, &how);
+    if (r == 0 && verify_opt) {
+        r = verify_dest(out, dest);
+        snprintf(how_buf, sizeof(how_buf), "%s, verified", how);
+        how = how_buf;
+    }
+    if (stats_on) cost->data_ns = stats_clock() - t0;
+    if (r != 0 ||
+        ((preserve_mask & PRESERVE_ATTRS) &&
+         preserve_attributes(in, out, &st_in, dest) != 0)) {
+        close(in);
+        close(out);
+        return -1;
+    }
+    if (verbose_opt) {
+        print_verbose_message(src, dest, how);
+    }
+
+    if (close(in) < 0) perror("close src");
+    if (close(out) < 0) {
+        perror("close dst");
+        return -1;
+    }
+    return 0;
+}
+
+// 파일 하나를 복사합니다. 0: 복사함, 1: --update 로 건너뜀, -1: 실패
+// src_dfd/src_name, dst_dfd/dst_name 으로 열고, src/dest 는 메시지에만 씁니다.
+static int copy_file_once(int src_dfd, const char *src_name, int dst_dfd,
+                          const char *dst_name, const char *src,
+                          const char *dest, struct file_cost *cost) {
+    struct link_entry *le = NULL;
+    struct stat st_in;
+    bool owner = false;
+    int in, r;
+
+    in = openat(src_dfd, src_name, O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        perror("open src");
+        return -1;
+    }
+    if (fstat(in, &st_in) != 0) {
+        perror("fstat src");
+        close(in);
+        return -1;
+    }
+    cost->bytes = st_in.st_size;
+
+    if ((preserve_mask & PRESERVE_LINKS) && st_in.st_nlink > 1 &&
+        (le = link_claim(&st_in, dest, &owner)) != NULL && !owner) {
+        r = link_to_first(le, dst_dfd, dst_name, src, dest);
+        if (r != -2) {
+            close(in);
+            cost->bytes = 0; /* 데이터는 옮기지 않음 */
+            return r;
+        }
+        le = NULL; /* 링크할 수 없는 위치: 따로 복사 */
+    }
+    r = copy_opened_file(in, &st_in, dst_dfd, dst_name, src, dest, cost);
+    if (le) link_finish(le, r >= 0, dst_dfd, dst_name);
+    return r;
+}
+
+int copy_file(const char *src, const char *dest) {
+    return copy_file_at(AT_FDCWD, src, AT_FDCWD, dest, src, dest);
+}
+
+int copy_file_at(int src_dfd, const char *src_name, int dst_dfd,
+                 const char *dst_name, const char *src, const char *dest) {
+    struct file_cost cost = {0, 0};
+    unsigned long t0 = stats_clock();
+    int r = copy_file_once(src_dfd, src_name, dst_dfd, dst_name, src, dest,
+                           &cost);
+
+    if (stats_on)
+        stats_add_file(r == 0, cost.bytes, stats_clock() - t0, cost.data_ns);
+    if (r < 0) {
+        atomic_fetch_add(&summary.failed, 1);
+        return -1;
+    }
+    atomic_fetch_add(r > 0 ? &summary.skipped : &summary.copied, 1);
+    return 0;
+}
+
+// 두 파일을 블록 단위로 비교합니다. 같으면 1, 다르면 0, 에러면 -1
+static int same_contents(int a, int b) {
+    char *buf = malloc(2 * BUFFSIZE);
+    off_t off = 0;
+    ssize_t na, nb;
+    int ret = 1;
+
+    if (!buf) {
+        perror("malloc");
+        return -1;
+    }
+    for (;;) {
+        na = pread(a, buf, BUFFSIZE, off);
+        nb = pread(b, buf + BUFFSIZE, BUFFSIZE, off);
+        if (na < 0 || nb < 0) {
+            perror("pread");
+            ret = -1;
+            break;
+        }
+        if (na != nb || memcmp(buf, buf + BUFFSIZE, na) != 0) {
+            ret = 0;
+            break;
+        }
+        if (na == 0) break; /* 둘 다 EOF */
+        off += na;
+    }
+    free(buf);
+    return ret;
+}
+
+// --update: dest 가 src 와 같다고 볼 수 있으면 1, 복사가 필요하면 0, 에러 -1
+// 크기가 다르면 무조건 복사. 크기가 같으면 --checksum 일 때 내용을,
+// 아니면 mtime 을 비교해 dest 가 src 보다 오래되지 않았으면 건너뜁니다.
+int dest_is_up_to_date(int in, const struct stat *st_in, int dst_dfd,
+                       const char *dst_name) {
+    struct stat st_dst;
+    int fd, r;
+
+    if (fstatat(dst_dfd, dst_name, &st_dst, 0) != 0) {
+        if (errno == ENOENT) return 0;
+        perror("stat dest");
+        return -1;
+    }
+    if (!S_ISREG(st_dst.st_mode) || st_dst.st_size != st_in->st_size)
+        return 0;
+
+    if (!checksum_opt) {
+        if (st_dst.st_mtim.tv_sec != st_in->st_mtim.tv_sec)
+            return st_dst.st_mtim.tv_sec > st_in->st_mtim.tv_sec;
+        return st_dst.st_mtim.tv_nsec >= st_in->st_mtim.tv_nsec;
+    }
+
+    if ((fd = openat(dst_dfd, dst_name, O_RDONLY | O_CLOEXEC)) < 0) {
+        perror("open dest");
+        return -1;
+    }
+    r = same_contents(in, fd);
+    close(fd);
+    return r;
+}
+
+/*
+ * --verify: 복사하면서 CRC32C 를 구하고 끝나면 dest 를 읽어 비교
+ *
+ * 원본 데이터가 사용자 공간 버퍼를 지나가는 경로(read/write, 희소,
+ * --direct, 파이프라인)에서 버퍼마다 verify_update 를 불러 CRC 를 쌓으므로
+ * 원본을 두 번 읽지 않습니다. 그래서 --verify 면 데이터를 버퍼로 보지 못하는
+ * reflink/copy_file_range/sendfile 은 쓰지 않습니다.
+ * dest 는 fdatasync 후 페이지 캐시를 버리고 다시 읽으므로 캐시가 아니라
+ * 디스크에 쓰인 내용을 확인합니다.
+ *
+ * CRC32C 는 SSE4.2 의 crc32 명령이 있으면 그것을, 없으면 slicing-by-8 표
+ * 방식을 씁니다. 어느 쪽을 쓸지는 crc32c_init 에서 CPU 를 보고 정합니다.
+ * stats_progress 와 같이 파일 하나는 한 스레드가 처리하므로 진행 중인 CRC 는
+ * 스레드별 변수에 둡니다.
+ */
+#define CRC32C_POLY 0x82f63b78 /* Castagnoli, 비트 반전 표현 */
+
+static uint32_t crc32c_table[8][256];
+static uint32_t (*crc32c)(uint32_t crc, const void *buf, size_t len);
+static _Thread_local uint32_t verify_crc;
+static _Thread_local off_t verify_len;
+
+static uint32_t crc32c_sw(uint32_t crc, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+
+    crc = ~crc;
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        v ^= crc; /* little-endian 가정 */
+        crc = crc32c_table[7][v & 0xff] ^ crc32c_table[6][(v >> 8) & 0xff] ^
+              crc32c_table[5][(v >> 16) & 0xff] ^
+              crc32c_table[4][(v >> 24) & 0xff] ^
+              crc32c_table[3][(v >> 32) & 0xff] ^
+              crc32c_table[2][(v >> 40) & 0xff] ^
+              crc32c_table[1][(v >> 48) & 0xff] ^ crc32c_table[0][v >> 56];
+        p += 8;
+        len -= 8;
+    }
+    while (len--) crc = crc32c_table[0][(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) static uint32_t
+crc32c_sse42(uint32_t crc, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+    uint64_t c = ~crc;
+
+    while (len >= 8) {
+        uint64_t v;
+        memcpy(&v, p, 8);
+        c = _mm_crc32_u64(c, v);
+        p += 8;
+        len -= 8;
+    }
+    while (len--) c = _mm_crc32_u8((uint32_t)c, *p++);
+    return ~(uint32_t)c;
+}
+#endif
+
+void crc32c_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c >> 1) ^ (CRC32C_POLY & -(c & 1));
+        crc32c_table[0][i] = c;
+    }
+    for (int t = 1; t < 8; t++)
+        for (int i = 0; i < 256; i++)
+            crc32c_table[t][i] = (crc32c_table[t - 1][i] >> 8) ^
+                                 crc32c_table[0][crc32c_table[t - 1][i] & 0xff];
+    crc32c = crc32c_sw;
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) crc32c = crc32c_sse42;
+#endif
+}
+
+void verify_begin(void) {
+    verify_crc = 0;
+    verify_len = 0;
+}
+
+// 데이터 복사 루프가 원본에서 읽은 버퍼를 넘겨 CRC 에 더합니다.
+void verify_update(const void *buf, size_t len) {
+    if (!verify_opt) return;
+    verify_crc = crc32c(verify_crc, buf, len);
+    verify_len += (off_t)len;
+}
+
+// 희소 파일의 구멍처럼 버퍼를 지나지 않은 0 바이트 len 개를 CRC 에 더합니다.
+void verify_zeros(off_t len) {
+    static const char zeros[64 * 1024];
+
+    while (verify_opt && len > 0) {
+        size_t n = len < (off_t)sizeof(zeros) ? (size_t)len : sizeof(zeros);
+        verify_update(zeros, n);
+        len -= n;
+    }
+}
+
+// dest 를 디스크에서 다시 읽어 복사하면서 구한 CRC 와 비교합니다.
+// out 은 O_RDWR 로 열려 있어야 합니다. 같으면 0
+int verify_dest(int out, const char *dest) {
+    uint32_t crc = 0;
+    off_t off = 0;
+    ssize_t n;
+    char *buf;
+
+    if (fdatasync(out) != 0) {
+        perror("fdatasync");
+        return -1;
+    }
+    posix_fadvise(out, 0, 0, POSIX_FADV_DONTNEED);
+    if ((buf = malloc(MAX_IO_BUFFER)) == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    while ((n = pread(out, buf, MAX_IO_BUFFER, off)) > 0) {
+        crc = crc32c(crc, buf, n);
+        off += n;
+    }
+    free(buf);
+    if (n < 0) {
+        perror("pread dest");
+        return -1;
+    }
+    if (off != verify_len || crc != verify_crc) {
+        fprintf(stderr,
+                "verify failed: %s (crc32c %08x, %lld bytes; expected %08x, "
+                "%lld bytes)\n",
+                dest, crc, (long long)off, verify_crc,
+                (long long)verify_len);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 파일 데이터 복사 전략
+ *
+ * 0. reflink (FICLONE): 데이터를 옮기지 않고 extent 를 공유 (btrfs, XFS 등)
+ *    --reflink=never 면 건너뛰고, always 면 실패 시 폴백 없이 에러
+ * 1. copy_file_range: 커널 안에서 바로 복사 (같은 fs 면 서버측 복사/공유도 가능)
+ * 2. sendfile: 페이지 캐시에서 바로 보냄, 사용자 공간 버퍼 없음
+ * 3. read/write: 어디서나 동작하는 마지막 수단 (io_buffer_size 버퍼)
+ *
+ * src 와 dest 의 장치가 다르고 PIPELINE_MIN_SIZE 이상이면 1~3 대신
+ * copy_pipeline 으로 읽기와 쓰기를 겹칩니다. (장치가 다르면 커널 복사도
+ * 결국 한 스레드에서 읽고 쓰기를 번갈아 하므로)
+ *
+ * --direct 면 DIRECT_MIN_SIZE 이상인 파일은 1~3 대신 copy_direct 를 씁니다.
+ *
+ * 어떤 전략이 되는지는 파일 시스템 조합에 따라 다르므로, (src 장치, dest 장치)
+ * 쌍마다 실패한 전략을 기억해 두고 다음 파일부터는 건너뜁니다.
+ * 한 번 내려간 전략은 다시 올라가지 않습니다.
+ */
+enum copy_strategy {
+    COPY_REFLINK,
+    COPY_RANGE,
+    COPY_SENDFILE,
+    COPY_READ_WRITE,
+};
+
+static const char *copy_strategy_names[] = {"reflink", "copy_file_range",
+                                            "sendfile", "read/write"};
+
+struct strategy_cache_entry {
+    dev_t src_dev, dst_dev;
+    enum copy_strategy strategy;
+};
+
+static struct strategy_cache_entry strategy_cache[STRATEGY_CACHE_SIZE];
+static int strategy_cache_len = 0;
+static pthread_mutex_t strategy_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static enum copy_strategy strategy_lookup(dev_t src_dev, dev_t dst_dev) {
+    enum copy_strategy s =
+        (reflink_opt == REFLINK_NEVER) ? COPY_RANGE : COPY_REFLINK;
+    pthread_mutex_lock(&strategy_cache_lock);
+    for (int i = 0; i < strategy_cache_len; i++) {
+        if (strategy_cache[i].src_dev == src_dev &&
+            strategy_cache[i].dst_dev == dst_dev) {
+            s = strategy_cache[i].strategy;
+            break;
+        }
+    }
+    pthread_mutex_unlock(&strategy_cache_lock);
+    return s;
+}
+
+static void strategy_demote(dev_t src_dev, dev_t dst_dev,
+                            enum copy_strategy s) {
+    int i;
+    pthread_mutex_lock(&strategy_cache_lock);
+    for (i = 0; i < strategy_cache_len; i++) {
+        if (strategy_cache[i].src_dev == src_dev &&
+            strategy_cache[i].dst_dev == dst_dev)
+            break;
+    }
+    if (i == strategy_cache_len) {
+        if (strategy_cache_len == STRATEGY_CACHE_SIZE) {
+            /* 가득 차면 기억하지 않음 (매 파일마다 다시 시도할 뿐) */
+            pthread_mutex_unlock(&strategy_cache_lock);
+            return;
+        }
+        strategy_cache[i].src_dev = src_dev;
+        strategy_cache[i].dst_dev = dst_dev;
+        strategy_cache[i].strategy = s;
+        strategy_cache_len++;
+    } else if (strategy_cache[i].strategy < s) {
+        strategy_cache[i].strategy = s;
+    }
+    pthread_mutex_unlock(&strategy_cache_lock);
+}
+
+// 이 errno 들은 "이 조합에서는 해당 시스템 콜을 쓸 수 없음" 을 뜻하므로
+// 다음 전략으로 넘어갑니다. 그 외 에러는 진짜 I/O 에러로 처리합니다.
+static bool strategy_unsupported(int err) {
+    return err == ENOSYS || err == EXDEV || err == EINVAL ||
+           err == EOPNOTSUPP || err == ENOTSUP || err == EBADF ||
+           err == ENOTTY; /* ioctl 자체를 모르는 파일 시스템 */
+}
+
+static int copy_read_write(int in, int out, size_t bufsize) {
+    ssize_t n;
+    char *buf = malloc(bufsize);
+    if (!buf) {
+        perror("malloc");
+        return -1;
+    }
+    while ((n = read(in, buf, bufsize)) > 0) {
+        verify_update(buf, n);
+        if (write(out, buf, n) != n) {
+            perror("write");
+            free(buf);
+            return -1;
+        }
+        stats_progress(n);
+    }
+    free(buf);
+    if (n < 0) {
+        perror("read");
+        return -1;
+    }
+    return 0;
+}
+
+/*
+ * 희소(sparse) 파일 복사
+ *
+ * SEEK_DATA/SEEK_HOLE 로 원본의 데이터 구간만 찾아 같은 오프셋에 쓰고,
+ * 마지막에 ftruncate 로 크기를 맞춥니다. 쓰지 않은 구간은 dest 에서도
+ * 구멍(hole)으로 남습니다. (dest 는 O_TRUNC 로 열린 빈 파일이어야 함)
+ * zero_detect 가 켜지면(--sparse=always) 데이터 구간 안의 0 블록도 쓰지 않고
+ * 구멍으로 만듭니다.
+ */
+static bool block_is_zero(const char *p, size_t len) {
+    /* 첫 바이트가 0 이고 나머지가 한 칸 밀린 자기 자신과 같으면 전부 0 */
+    return len == 0 || (p[0] == 0 && memcmp(p, p + 1, len - 1) == 0);
+}
+
+// [off, off + len) 구간을 pread/pwrite 로 복사합니다.
+// zero_blk > 0 이면 zero_blk 단위로 0 인 블록은 건너뜁니다.
+static int copy_segment_rw(int in, int out, off_t off, off_t len,
+                           size_t zero_blk, size_t bufsize) {
+    char *buf = malloc(bufsize);
+    if (!buf) {
+        perror("malloc");
+        return -1;
+    }
+    while (len > 0) {
+        size_t want = len < (off_t)bufsize ? (size_t)len : bufsize;
+        ssize_t n = pread(in, buf, want, off);
+        if (n < 0) {
+            perror("pread");
+            free(buf);
+            return -1;
+        }
+        if (n == 0) break; /* 복사 도중 원본이 줄어듦 */
+        verify_update(buf, n);
+        for (ssize_t done = 0; done < n;) {
+            size_t chunk = zero_blk ? zero_blk : (size_t)n;
+            if (chunk > (size_t)(n - done)) chunk = n - done;
+            if (!zero_blk || !block_is_zero(buf + done, chunk)) {
+                if (pwrite(out, buf + done, chunk, off + done) !=
+                    (ssize_t)chunk) {
+                    perror("pwrite");
+                    free(buf);
+                    return -1;
+                }
+            }
+            done += chunk;
+        }
+        stats_progress(n);
+        off += n;
+        len -= n;
+    }
+    free(buf);
+    return 0;
+}
+
+static int copy_segment(int in, int out, off_t off, off_t len,
+                        bool use_range, size_t zero_blk, size_t bufsize) {
+    if (use_range && !zero_blk) {
+        loff_t off_in = off, off_out = off;
+        while (len > 0) {
+            ssize_t n = copy_file_range(in, &off_in, out, &off_out,
+                                        len < copy_chunk ? (size_t)len
+                                                         : (size_t)copy_chunk,
+                                        0);
+            if (n < 0) {
+                if (!strategy_unsupported(errno)) {
+                    perror("copy_file_range");
+                    return -1;
+                }
+                break; /* 남은 부분은 pread/pwrite 로 */
+            }
+            if (n == 0) return 0;
+            stats_progress(n);
+            len -= n;
+        }
+        off = off_in;
+    }
+    return len > 0 ? copy_segment_rw(in, out, off, len, zero_blk, bufsize)
+                   : 0;
+}
+
+// read/write 경로의 버퍼 크기를 고릅니다. (--buffer-size 가 있으면 그 값)
+// 블록 크기의 IO_BUFFER_BLOCKS 배를 [MIN_IO_BUFFER, MAX_IO_BUFFER] 로 자르고,
+// 아주 큰 파일은 MAX_IO_BUFFER 를, 버퍼보다 작은 파일은 파일 크기(블록
+// 단위로 올림)만큼만 씁니다.
+static size_t io_buffer_size(const struct stat *st_in,
+                             const struct stat *st_out) {
+    size_t blk = st_in->st_blksize > st_out->st_blksize ? st_in->st_blksize
+                                                        : st_out->st_blksize;
+    size_t want;
+
+    if (buffer_size_opt) return buffer_size_opt;
+    if (blk < DIRECT_ALIGN) blk = DIRECT_ALIGN;
+    want = blk * IO_BUFFER_BLOCKS;
+    if (want < MIN_IO_BUFFER) want = MIN_IO_BUFFER;
+    if (want > MAX_IO_BUFFER || st_in->st_size >= LARGE_FILE_SIZE)
+        want = MAX_IO_BUFFER;
+    /* /proc 처럼 크기를 모르는 파일(0)은 그대로 */
+    if (st_in->st_size > 0 && (off_t)want > st_in->st_size)
+        want = ((size_t)st_in->st_size + blk - 1) / blk * blk;
+    return want;
+}
+
+/*
+ * 장치가 다른 두 파일 사이의 파이프라인 복사
+ *
+ * read 와 write 를 번갈아 부르면 한 번에 한 장치만 일합니다. 여기서는
+ * 부른 스레드가 PIPELINE_BUFFERS 칸짜리 링을 채우고(reader), 따로 띄운
+ * 스레드가 비웁니다(writer). 두 장치가 동시에 일하므로 느린 디스크 사이의
+ * 복사가 두 지연의 합이 아니라 느린 쪽 속도에 가까워집니다.
+ *
+ * head 는 reader 가 다음에 채울 칸, tail 은 writer 가 다음에 비울 칸이며
+ * 둘 다 계속 증가하는 값입니다. (head - tail 이 찬 칸의 수)
+ */
+struct copy_pipe {
+    int in, out;
+    size_t bufsize;
+    char *bufs[PIPELINE_BUFFERS];
+    ssize_t lens[PIPELINE_BUFFERS];
+    unsigned int head, tail;
+    bool eof;      /* reader 가 끝남 (EOF 또는 에러) */
+    int write_err; /* writer 의 errno, 0 이면 정상 */
+    pthread_mutex_t lock;
+    pthread_cond_t not_full, not_empty;
+};
+
+static void *pipe_writer_main(void *arg) {
+    struct copy_pipe *p = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&p->lock);
+        while (p->head == p->tail && !p->eof)
+            pthread_cond_wait(&p->not_empty, &p->lock);
+        if (p->head == p->tail) { /* eof 이고 남은 칸 없음 */
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+        unsigned int slot = p->tail % PIPELINE_BUFFERS;
+        pthread_mutex_unlock(&p->lock);
+
+        for (ssize_t done = 0; done < p->lens[slot];) {
+            ssize_t n = write(p->out, p->bufs[slot] + done,
+                              p->lens[slot] - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                pthread_mutex_lock(&p->lock);
+                p->write_err = n < 0 ? errno : EIO;
+                pthread_cond_signal(&p->not_full);
+                pthread_mutex_unlock(&p->lock);
+                return NULL;
+            }
+            done += n;
+        }
+
+        pthread_mutex_lock(&p->lock);
+        p->tail++;
+        pthread_cond_signal(&p->not_full);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+// in 의 현재 위치부터 끝까지 out 으로 복사합니다. 스레드를 만들 수 없으면
+// copy_read_write 로 대신합니다.
+static int copy_pipeline(int in, int out, size_t bufsize) {
+    struct copy_pipe p = {.in = in, .out = out, .bufsize = bufsize};
+    pthread_t writer;
+    int read_err = 0, i;
+    ssize_t n = 0;
+
+    for (i = 0; i < PIPELINE_BUFFERS; i++) {
+        if ((p.bufs[i] = malloc(bufsize)) == NULL) {
+            while (i-- > 0) free(p.bufs[i]);
+            perror("malloc");
+            return -1;
+        }
+    }
+    pthread_mutex_init(&p.lock, NULL);
+    pthread_cond_init(&p.not_full, NULL);
+    pthread_cond_init(&p.not_empty, NULL);
+    if (pthread_create(&writer, NULL, pipe_writer_main, &p) != 0) {
+        for (i = 0; i < PIPELINE_BUFFERS; i++) free(p.bufs[i]);
+        pthread_mutex_destroy(&p.lock);
+        pthread_cond_destroy(&p.not_full);
+        pthread_cond_destroy(&p.not_empty);
+        return copy_read_write(in, out, bufsize);
+    }
+    posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    for (;;) {
+        pthread_mutex_lock(&p.lock);
+        while (p.head - p.tail == PIPELINE_BUFFERS && !p.write_err)
+            pthread_cond_wait(&p.not_full, &p.lock);
+        bool stop = p.write_err != 0;
+        unsigned int slot = p.head % PIPELINE_BUFFERS;
+        pthread_mutex_unlock(&p.lock);
+        if (stop) break;
+
+        n = read(in, p.bufs[slot], bufsize);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n < 0) read_err = errno;
+            break;
+        }
+        /* 진행 상황과 CRC 는 reader 스레드에서 셈 (둘 다 스레드별) */
+        stats_progress(n);
+        verify_update(p.bufs[slot], n);
+
+        pthread_mutex_lock(&p.lock);
+        p.lens[slot] = n;
+        p.head++;
+        pthread_cond_signal(&p.not_empty);
+        pthread_mutex_unlock(&p.lock);
+    }
+
+    pthread_mutex_lock(&p.lock);
+    p.eof = true;
+    pthread_cond_signal(&p.not_empty);
+    pthread_mutex_unlock(&p.lock);
+    pthread_join(writer, NULL);
+
+    for (i = 0; i < PIPELINE_BUFFERS; i++) free(p.bufs[i]);
+    pthread_mutex_destroy(&p.lock);
+    pthread_cond_destroy(&p.not_full);
+    pthread_cond_destroy(&p.not_empty);
+
+    if (read_err) {
+        errno = read_err;
+        perror("read");
+        return -1;
+    }
+    if (p.write_err) {
+        errno = p.write_err;
+        perror("write");
+        return -1;
+    }
+    return 0;
+}
+
+// [off, off + len) 의 dest 를 디스크로 내린 뒤 두 파일의 페이지 캐시를 버립니다.
+static void drop_cached_range(int in, int out, off_t off, off_t len) {
+    sync_file_range(out, off, len,
+                    SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+                        SYNC_FILE_RANGE_WAIT_AFTER);
+    posix_fadvise(out, off, len, POSIX_FADV_DONTNEED);
+    posix_fadvise(in, off, len, POSIX_FADV_DONTNEED);
+}
+
+// copy_direct 가 켠 O_DIRECT 를 끄고 두 fd 를 원래 플래그로 되돌림
+static void direct_off(int in, int out, int in_fl, int out_fl, bool *odirect) {
+    if (!*odirect) return;
+    fcntl(in, F_SETFL, in_fl);
+    fcntl(out, F_SETFL, out_fl);
+    *odirect = false;
+}
+
+/*
+ * --direct: 큰 파일을 페이지 캐시에 남기지 않고 복사
+ *
+ * 두 fd 에 O_DIRECT 를 켜고 정렬된 버퍼로 read/write 합니다. 마지막 블록처럼
+ * 정렬 단위로 떨어지지 않는 조각을 만나면 그때부터 O_DIRECT 를 끄고 씁니다.
+ * O_DIRECT 를 지원하지 않는 파일 시스템에서는 일반 read/write 로 복사하면서
+ * DIRECT_DROP_CHUNK 마다 dest 를 내리고 두 파일의 캐시를 버립니다.
+ * 어느 쪽이든 다른 프로세스가 쓰는 캐시를 복사 데이터로 밀어내지 않습니다.
+ */
+static int copy_direct(int in, int out, const struct stat *st_in,
+                       const struct stat *st_out, const char **how) {
+    size_t bufsize = (io_buffer_size(st_in, st_out) + DIRECT_ALIGN - 1) /
+                     DIRECT_ALIGN * DIRECT_ALIGN;
+    int in_fl = fcntl(in, F_GETFL), out_fl = fcntl(out, F_GETFL);
+    bool odirect = false;
+    off_t done = 0, dropped = 0;
+    ssize_t n;
+    void *buf;
+
+    if (in_fl >= 0 && out_fl >= 0 &&
+        fcntl(in, F_SETFL, in_fl | O_DIRECT) == 0) {
+        if (fcntl(out, F_SETFL, out_fl | O_DIRECT) == 0)
+            odirect = true;
+        else
+            fcntl(in, F_SETFL, in_fl);
+    }
+    *how = odirect ? "direct" : "read/write, cache dropped";
+
+    if ((errno = posix_memalign(&buf, DIRECT_ALIGN, bufsize)) != 0) {
+        perror("posix_memalign");
+        direct_off(in, out, in_fl, out_fl, &odirect);
+        return -1;
+    }
+    if (!odirect) posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+    while ((n = read(in, buf, bufsize)) > 0) {
+        verify_update(buf, n);
+        if (odirect && (size_t)n % DIRECT_ALIGN != 0) {
+            /* 끝 조각: 이후는 버퍼 I/O 로 (읽기 위치도 정렬이 깨지므로) */
+            direct_off(in, out, in_fl, out_fl, &odirect);
+            dropped = done;
+        }
+        if (write(out, buf, n) != n) {
+            perror("write");
+            free(buf);
+            direct_off(in, out, in_fl, out_fl, &odirect);
+            return -1;
+        }
+        done += n;
+        stats_progress(n);
+        if (!odirect && done - dropped >= DIRECT_DROP_CHUNK) {
+            drop_cached_range(in, out, dropped, done - dropped);
+            dropped = done;
+        }
+    }
+    free(buf);
+    if (n >= 0 && !odirect && done > dropped)
+        drop_cached_range(in, out, dropped, done - dropped);
+    /* 크기가 정렬 단위의 배수면 끝까지 O_DIRECT 이므로 여기서 끔.
+     * --verify 가 같은 fd 로 정렬되지 않은 버퍼에 pread 하므로 반드시 되돌려야 함 */
+    direct_off(in, out, in_fl, out_fl, &odirect);
+    if (n < 0) {
+        perror("read");
+        return -1;
+    }
+    return 0;
+}
+
+static int copy_sparse(int in, int out, const struct stat *st_in,
+                       const struct stat *st_out, bool use_range) {
+    size_t zero_blk = (sparse_opt == SPARSE_ALWAYS) ? st_out->st_blksize : 0;
+    size_t bufsize = io_buffer_size(st_in, st_out);
+    off_t data = 0, hole, fed = 0; /* fed: --verify 가 CRC 에 넣은 위치 */
+
+    while (data < st_in->st_size) {
+        if ((data = lseek(in, data, SEEK_DATA)) < 0) {
+            if (errno == ENXIO) break; /* 끝까지 구멍 */
+            if (errno != EINVAL) {
+                perror("lseek SEEK_DATA");
+                return -1;
+            }
+            /* SEEK_DATA 를 모르는 파일 시스템: 전체를 데이터 하나로 봄 */
+            data = 0;
+            hole = st_in->st_size;
+        } else if ((hole = lseek(in, data, SEEK_HOLE)) < 0) {
+            perror("lseek SEEK_HOLE");
+            return -1;
+        }
+        if (hole > st_in->st_size) hole = st_in->st_size;
+        verify_zeros(data - fed); /* 앞 구멍 */
+        fed = hole;
+        if (copy_segment(in, out, data, hole - data, use_range, zero_blk,
+                         bufsize) != 0)
+            return -1;
+        data = hole;
+    }
+    verify_zeros(st_in->st_size - fed); /* 끝 구멍 */
+    if (ftruncate(out, st_in->st_size) != 0) {
+        perror("ftruncate");
+        return -1;
+    }
+    return 0;
+}
+
+// in 의 현재 위치부터 끝까지 out 으로 복사합니다. 두 fd 의 파일 오프셋을
+// 그대로 쓰므로 중간에 전략을 바꿔도 이어서 복사됩니다.
+// *how 에는 실제로 사용한 전략 이름이 들어갑니다.
+int copy_file_data(int in, int out, const struct stat *st_in,
+                   const struct stat *st_out, const char **how) {
+    enum copy_strategy s = strategy_lookup(st_in->st_dev, st_out->st_dev);
+    off_t copied = 0;
+    ssize_t n;
+
+    /* --verify 는 데이터를 버퍼로 지나가게 해야 CRC 를 구할 수 있음 */
+    if (verify_opt) s = COPY_READ_WRITE;
+
+    if (s == COPY_REFLINK) {
+        if (ioctl(out, FICLONE, in) == 0) {
+            *how = copy_strategy_names[COPY_REFLINK];
+            return 0;
+        }
+        if (!strategy_unsupported(errno)) {
+            perror("ioctl FICLONE");
+            return -1;
+        }
+        s = COPY_RANGE;
+        strategy_demote(st_in->st_dev, st_out->st_dev, s);
+    }
+    if (reflink_opt == REFLINK_ALWAYS) {
+        /* 이전 파일에서 이미 안 된다고 기억된 경우도 여기로 옴 */
+        fprintf(stderr, "reflink not supported on this filesystem\n");
+        return -1;
+    }
+
+    /* 할당된 블록이 크기보다 적으면 구멍이 있는 파일 */
+    if (st_in->st_size > 0 &&
+        (sparse_opt == SPARSE_ALWAYS ||
+         (sparse_opt == SPARSE_AUTO &&
+          (off_t)st_in->st_blocks * 512 < st_in->st_size))) {
+        *how = (sparse_opt == SPARSE_ALWAYS) ? "sparse, zero blocks as holes"
+                                             : "sparse";
+        return copy_sparse(in, out, st_in, st_out, s == COPY_RANGE);
+    }
+
+    /*
+     * 크기가 0 으로 보이는 파일(/proc 등)은 커널 복사가 0 바이트로 끝나
+     * 버리므로 처음부터 read/write 로 읽습니다.
+     */
+    if (st_in->st_size == 0) s = COPY_READ_WRITE;
+
+    if (direct_opt && st_in->st_size >= DIRECT_MIN_SIZE)
+        return copy_direct(in, out, st_in, st_out, how);
+
+    if (st_in->st_dev != st_out->st_dev &&
+        st_in->st_size >= PIPELINE_MIN_SIZE) {
+        *how = "pipeline";
+        return copy_pipeline(in, out, io_buffer_size(st_in, st_out));
+    }
+
+    if (s == COPY_RANGE) {
+        while ((n = copy_file_range(in, NULL, out, NULL, copy_chunk, 0)) > 0) {
+            copied += n;
+            stats_progress(n);
+        }
+        if (n < 0 && !strategy_unsupported(errno)) {
+            perror("copy_file_range");
+            return -1;
+        }
+        if (n == 0 && copied >= st_in->st_size) {
+            *how = copy_strategy_names[COPY_RANGE];
+            return 0;
+        }
+        /* 지원되지 않거나 (n < 0) 크기보다 일찍 0 을 돌려준 경우.
+         * 일찍 0 은 복사 중 원본이 줄어든 것 등 이 파일만의 사정이므로
+         * 장치 쌍의 전략은 그대로 두고 이 파일만 다음 방법으로 이어서 복사 */
+        s = COPY_SENDFILE;
+        if (n < 0) strategy_demote(st_in->st_dev, st_out->st_dev, s);
+    }
+
+    if (s == COPY_SENDFILE) {
+        while ((n = sendfile(out, in, NULL, copy_chunk)) > 0) {
+            copied += n;
+            stats_progress(n);
+        }
+        if (n < 0 && !strategy_unsupported(errno)) {
+            perror("sendfile");
+            return -1;
+        }
+        if (n == 0 && copied >= st_in->st_size) {
+            *how = copy_strategy_names[COPY_SENDFILE];
+            return 0;
+        }
+        s = COPY_READ_WRITE;
+        if (n < 0) strategy_demote(st_in->st_dev, st_out->st_dev, s);
+    }
+
+    *how = copy_strategy_names[COPY_READ_WRITE];
+    /* 버퍼 여러 개 분량이면 readahead 창을 넓혀 달라고 알림 */
+    if (st_in->st_size > (off_t)MAX_IO_BUFFER)
+        posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return copy_read_write(in, out, io_buffer_size(st_in, st_out));
+}
+// 확장 속성(xattr) 이름 하나가 이번에 보존할 대상인지 판단합니다.
+// POSIX ACL 은 커널이 system.posix_acl_* xattr 로 저장하므로 별도 라이브러리
+// 없이 같은 방식으로 복사합니다.
+static bool xattr_selected(const char *name) {
+    bool is_acl = strncmp(name, "system.posix_acl_", 17) == 0;
+    return is_acl ? (preserve_mask & PRESERVE_ACL) != 0
+                  : (preserve_mask & PRESERVE_XATTR) != 0;
+}
+
+static int copy_xattrs(int src_fd, int dst_fd, const char *dest) {
+    ssize_t list_len, val_len;
+    char *list, *val = NULL;
+    size_t val_cap = 0;
+    int ret = 0;
+
+    if ((list_len = flistxattr(src_fd, NULL, 0)) <= 0) {
+        if (list_len < 0 && errno != ENOTSUP) {
+            perror("flistxattr");
+            return -1;
+        }
+        return 0; /* 속성이 없거나 원본 fs 가 xattr 미지원 */
+    }
+    if ((list = malloc(list_len)) == NULL) {
+        perror("malloc");
+        return -1;
+    }
+    if ((list_len = flistxattr(src_fd, list, list_len)) < 0) {
+        perror("flistxattr");
+        free(list);
+        return -1;
+    }
+
+    /* list 는 "이름\0이름\0..." 형태 */
+    for (char *name = list; ret == 0 && name < list + list_len;
+         name += strlen(name) + 1) {
+        if (!xattr_selected(name)) continue;
+        if ((val_len = fgetxattr(src_fd, name, NULL, 0)) < 0) {
+            if (errno == ENODATA) continue; /* 목록을 읽은 뒤 지워진 속성 */
+            perror("fgetxattr");
+            ret = -1;
+            break;
+        }
+        if ((size_t)val_len > val_cap) {
+            char *nv = realloc(val, val_len);
+            if (!nv) {
+                perror("realloc");
+                ret = -1;
+                break;
+            }
+            val = nv;
+            val_cap = val_len;
+        }
+        if ((val_len = fgetxattr(src_fd, name, val, val_len)) < 0) {
+            if (errno == ENODATA) continue; /* 목록을 읽은 뒤 지워진 속성 */
+            perror("fgetxattr");
+            ret = -1;
+        } else if (fsetxattr(dst_fd, name, val, val_len, 0) != 0) {
+            if (errno == ENOTSUP || errno == EPERM || errno == EACCES) {
+                /* dest 파일 시스템이 지원하지 않거나, root 가 아니라서
+                 * security.* / trusted.* 를 쓸 수 없으면 경고만 하고 진행 */
+                fprintf(stderr, "Warning: cannot preserve %s on %s\n", name,
+                        dest);
+            } else {
+                perror("fsetxattr");
+                ret = -1;
+            }
+        }
+    }
+    free(val);
+    free(list);
+    return ret;
+}
+
+// 이미 열려 있는 dest fd 에 원본 속성(st, src_fd)을 적용합니다.
+// 순서: 소유자 → 권한 → xattr/ACL → 시간. chown 은 setuid 비트를 지우고,
+// 쓰기/속성 변경은 시간을 바꾸므로 시간은 항상 마지막에 맞춥니다.
+int preserve_attributes(int src_fd, int dst_fd, const struct stat *st,
+                        const char *dest) {
+    if ((preserve_mask & PRESERVE_OWNERSHIP) &&
+        fchown(dst_fd, st->st_uid, st->st_gid) != 0) {
+        if (errno != EPERM) {
+            perror("fchown");
+            return -1;
+        }
+        /* root 가 아니면 남의 소유로 바꿀 수 없음: 경고만 */
+        fprintf(stderr, "Warning: cannot preserve ownership of %s\n", dest);
+    }
+    if ((preserve_mask & PRESERVE_MODE) &&
+        fchmod(dst_fd, st->st_mode & 07777) != 0) {
+        perror("chmod");
+        return -1;
+    }
+    if ((preserve_mask & (PRESERVE_XATTR | PRESERVE_ACL)) &&
+        copy_xattrs(src_fd, dst_fd, dest) != 0)
+        return -1;
+    if (preserve_mask & PRESERVE_TIMESTAMPS) {
+        struct timespec times[2];
+        times[0] = st->st_atim;
+        times[1] = st->st_mtim;
+        if (futimens(dst_fd, times) != 0) {
+            perror("utimensat");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/*
+ * --stats / --progress 계측
+ *
+ * 복사한 파일마다 걸린 시간을 원본 크기 구간별 로그 히스토그램에 넣고,
+ * 그중 copy_file_data 에 쓴 시간(data)과 나머지 open/fstat/생성/속성
+ * 보존/디렉터리 생성 등에 쓴 시간(metadata)을 따로 더합니다. 두 시간은
+ * 작업자 스레드들의 시간을 합친 값이라 -j N 이면 경과 시간보다 클 수
+ * 있습니다.
+ *
+ * 히스토그램 칸은 2의 거듭제곱 구간을 다시 4등분한 것이라 백분위 값의
+ * 오차는 25% 이내입니다. 모든 카운터는 원자적 덧셈만 하므로 작업자들이
+ * 잠금 없이 기록합니다. 계측을 켜지 않으면 시계를 읽지 않습니다.
+ */
+static const struct {
+    off_t limit; /* 이 크기 미만 */
+    const char *label;
+} stats_size_buckets[STATS_SIZE_BUCKETS] = {
+    {4 * 1024, "<4KiB"},
+    {64 * 1024, "4KiB-64KiB"},
+    {1024 * 1024, "64KiB-1MiB"},
+    {16 * 1024 * 1024, "1MiB-16MiB"},
+    {0, ">=16MiB"}, /* 나머지 전부 */
+};
+
+struct copy_stats {
+    unsigned long start_ns;
+    atomic_ulong bytes;   /* 복사한 파일들의 원본 크기 합 */
+    atomic_ulong file_ns; /* 파일 하나를 처리하는 데 쓴 전체 시간의 합 */
+    atomic_ulong data_ns; /* 그중 데이터 복사에 쓴 시간 */
+    atomic_ulong dir_ns;  /* 디렉터리 열기/만들기에 쓴 시간 */
+    atomic_ulong inflight; /* 복사 중인 파일들이 지금까지 쓴 바이트 */
+    atomic_ulong lat[STATS_SIZE_BUCKETS][STATS_LAT_SLOTS];
+    atomic_ulong lat_max[STATS_SIZE_BUCKETS];
+};
+
+static struct copy_stats stats;
+static pthread_t progress_tid;
+static pthread_mutex_t progress_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t progress_cond = PTHREAD_COND_INITIALIZER;
+static bool progress_stop = false;
+/* 이 스레드가 지금 복사 중인 파일에서 inflight 에 더한 양 */
+static _Thread_local unsigned long inflight_mine;
+
+// 계측이 켜져 있을 때만 단조 시계를 ns 로 읽습니다. 꺼져 있으면 0
+unsigned long stats_clock(void) {
+    struct timespec ts;
+
+    if (!stats_on) return 0;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)ts.tv_sec * 1000000000UL +
+           (unsigned long)ts.tv_nsec;
+}
+
+static int stats_lat_slot(unsigned long ns) {
+    int msb;
+
+    if (ns < 4) return (int)ns;
+    msb = 63 - __builtin_clzl(ns);
+    return msb * 4 + (int)((ns >> (msb - 2)) & 3);
+}
+
+// 칸의 상한 (ns). 백분위는 보수적으로 이 값으로 보고합니다.
+static unsigned long stats_lat_slot_upper(int slot) {
+    int msb = slot / 4, sub = slot % 4;
+
+    if (slot < 4) return (unsigned long)slot;
+    return ((unsigned long)(4 + sub + 1) << (msb - 2)) - 1;
+}
+
+// 디렉터리 메타데이터 작업 시간을 더합니다. t0 는 stats_clock() 값
+void stats_add_dir(unsigned long t0) {
+    if (!stats_on) return;
+    atomic_fetch_add(&stats.dir_ns, stats_clock() - t0);
+}
+
+// 데이터 복사 루프에서 n 바이트를 쓸 때마다 불러 진행 상황에 반영합니다.
+void stats_progress(ssize_t n) {
+    if (!stats_on) return;
+    atomic_fetch_add(&stats.inflight, (unsigned long)n);
+    inflight_mine += (unsigned long)n;
+}
+
+// 파일 하나의 결과를 기록합니다. copied 가 아니면 (건너뜀/실패) 시간만
+// 메타데이터 쪽에 더하고 히스토그램에는 넣지 않습니다.
+void stats_add_file(bool copied, off_t size, unsigned long ns,
+                    unsigned long data_ns) {
+    int b;
+    unsigned long max;
+
+    if (!stats_on) return;
+    atomic_fetch_sub(&stats.inflight, inflight_mine);
+    inflight_mine = 0;
+    atomic_fetch_add(&stats.file_ns, ns);
+    atomic_fetch_add(&stats.data_ns, data_ns);
+    if (!copied) return;
+
+    atomic_fetch_add(&stats.bytes, (unsigned long)size);
+    for (b = 0; b < STATS_SIZE_BUCKETS - 1; b++)
+        if (size < stats_size_buckets[b].limit) break;
+    atomic_fetch_add(&stats.lat[b][stats_lat_slot(ns)], 1);
+    max = atomic_load(&stats.lat_max[b]);
+    while (ns > max &&
+           !atomic_compare_exchange_weak(&stats.lat_max[b], &max, ns))
+        ;
+}
+
+static double stats_elapsed(void) {
+    return (double)(stats_clock() - stats.start_ns) / 1e9;
+}
+
+static void print_progress_line(bool final) {
+    double secs = stats_elapsed();
+    unsigned long files = atomic_load(&summary.copied);
+    double mib = (double)(atomic_load(&stats.bytes) +
+                          atomic_load(&stats.inflight)) /
+                 (1024.0 * 1024.0);
+
+    if (secs <= 0) secs = 1e-9;
+    /* 터미널이면 한 줄을 덮어쓰고, 아니면 (로그 파일 등) 줄마다 남깁니다. */
+    fprintf(stderr, "%s%lu files, %.1f MiB, %.1f MiB/s, %.0f files/s, "
+            "skipped %lu, failed %lu%s",
+            isatty(STDERR_FILENO) ? "\r" : "", files, mib, mib / secs,
+            (double)files / secs, atomic_load(&summary.skipped),
+            atomic_load(&summary.failed),
+            (final || !isatty(STDERR_FILENO)) ? "\n" : "");
+}
+
+static void *progress_main(void *arg) {
+    struct timespec deadline;
+
+    (void)arg;
+    pthread_mutex_lock(&progress_lock);
+    while (!progress_stop) {
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += PROGRESS_INTERVAL_SEC;
+        while (!progress_stop &&
+               pthread_cond_timedwait(&progress_cond, &progress_lock,
+                                      &deadline) != ETIMEDOUT)
+            ;
+        if (!progress_stop) print_progress_line(false);
+    }
+    pthread_mutex_unlock(&progress_lock);
+    return NULL;
+}
+
+// 계측을 시작합니다. --progress 면 진행 상황 출력 스레드도 띄웁니다.
+void stats_start(void) {
+    stats.start_ns = stats_clock();
+    if (progress_opt &&
+        pthread_create(&progress_tid, NULL, progress_main, NULL) != 0) {
+        perror("pthread_create progress");
+        progress_opt = false;
+    }
+}
+
+// 진행 상황 스레드를 멈추고, --stats 면 JSON 보고서를 씁니다.
+int stats_finish(void) {
+    double secs = stats_elapsed();
+    unsigned long files = atomic_load(&summary.copied);
+    unsigned long bytes = atomic_load(&stats.bytes);
+    unsigned long file_ns = atomic_load(&stats.file_ns);
+    unsigned long data_ns = atomic_load(&stats.data_ns);
+    unsigned long meta_ns = file_ns - data_ns + atomic_load(&stats.dir_ns);
+    FILE *fp;
+
+    if (progress_opt) {
+        pthread_mutex_lock(&progress_lock);
+        progress_stop = true;
+        pthread_cond_signal(&progress_cond);
+        pthread_mutex_unlock(&progress_lock);
+        pthread_join(progress_tid, NULL);
+        print_progress_line(true);
+    }
+    if (!stats_opt) return 0;
+
+    if (stats_path == NULL || strcmp(stats_path, "-") == 0) {
+        fp = stdout;
+    } else if ((fp = fopen(stats_path, "w")) == NULL) {
+        perror("open stats file");
+        return -1;
+    }
+    if (secs <= 0) secs = 1e-9;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"elapsed_s\": %.6f,\n", secs);
+    fprintf(fp, "  \"jobs\": %d,\n", jobs_opt);
+    fprintf(fp,
+            "  \"files\": {\"copied\": %lu, \"skipped\": %lu, "
+            "\"failed\": %lu},\n",
+            files, atomic_load(&summary.skipped),
+            atomic_load(&summary.failed));
+    fprintf(fp, "  \"bytes\": %lu,\n", bytes);
+    fprintf(fp, "  \"bytes_per_s\": %.0f,\n", (double)bytes / secs);
+    fprintf(fp, "  \"files_per_s\": %.1f,\n", (double)files / secs);
+    fprintf(fp, "  \"busy_s\": {\"data\": %.6f, \"metadata\": %.6f},\n",
+            (double)data_ns / 1e9, (double)meta_ns / 1e9);
+    fprintf(fp, "  \"latency_us\": [");
+    for (int b = 0; b < STATS_SIZE_BUCKETS; b++) {
+        static const double pct[] = {0.50, 0.90, 0.99};
+        unsigned long count = 0, seen = 0, vals[3] = {0, 0, 0};
+        int p = 0;
+
+        for (int s = 0; s < STATS_LAT_SLOTS; s++)
+            count += atomic_load(&stats.lat[b][s]);
+        for (int s = 0; s < STATS_LAT_SLOTS && p < 3; s++) {
+            seen += atomic_load(&stats.lat[b][s]);
+            while (p < 3 && count > 0 && seen >= pct[p] * count)
+                vals[p++] = stats_lat_slot_upper(s);
+        }
+        for (p = 0; p < 3; p++) /* 칸 상한이 실제 최댓값을 넘지 않게 */
+            if (vals[p] > atomic_load(&stats.lat_max[b]))
+                vals[p] = atomic_load(&stats.lat_max[b]);
+        fprintf(fp,
+                "%s\n    {\"size\": \"%s\", \"count\": %lu, \"p50\": %.1f, "
+                "\"p90\": %.1f, \"p99\": %.1f, \"max\": %.1f}",
+                b ? "," : "", stats_size_buckets[b].label, count,
+                vals[0] / 1e3, vals[1] / 1e3, vals[2] / 1e3,
+                atomic_load(&stats.lat_max[b]) / 1e3);
+    }
+    fprintf(fp, "\n  ]\n}\n");
+
+    if (fp != stdout && fclose(fp) != 0) {
+        perror("close stats file");
+        return -1;
+    }
+    return 0;
+}
+
+// 재귀 복사는 트리 깊이만큼 디렉터리 fd 를 열어 두므로, soft 한도를
+// hard 한도까지 올립니다. 실패해도 기존 한도로 계속 진행합니다.
+void raise_fd_limit(void) {
+    struct rlimit rl;
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
     }
 }
 // src와 name을 합쳐서 동적으로 경로 문자열을 할당하는 함수
@@ -457,9 +3206,90 @@ int safe_mkdir(const char *path, mode_t mode) {
     }
     return 0;
 }
+/*
+ * 있는 것이 확인된 디렉터리 경로 캐시 (mkdirs 용)
+ *
+ * mkdirs 는 경로 성분마다 lstat(+mkdir) 을 부릅니다. --from-manifest 처럼
+ * 같은 dest 디렉터리 아래로 파일을 많이 복사하면 같은 확인이 계속
+ * 반복되므로, 한 번 만들었거나 디렉터리임을 확인한 경로 문자열을 기억해
+ * 두고 다음부터는 시스템 콜 없이 넘어갑니다. 경로는 받은 문자열 그대로
+ * (작업 디렉터리 기준) 쓰며, 복사 도중 다른 프로세스가 지우는 경우는
+ * 고려하지 않습니다. 작업자 스레드들이 함께 쓰므로 lock 으로 보호합니다.
+ */
+struct dir_cache {
+    char **slots; /* open addressing, NULL 이면 빈 칸 */
+    size_t cap;   /* 2의 거듭제곱 */
+    size_t count;
+    pthread_mutex_t lock;
+};
+
+static struct dir_cache dir_cache = {NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER};
+
+static size_t dir_cache_hash(const char *path) {
+    size_t h = 1469598103934665603ULL; /* FNV-1a */
+    for (; *path; path++) h = (h ^ (unsigned char)*path) * 1099511628211ULL;
+    return h;
+}
+
+static bool dir_cache_has(const char *path) {
+    bool found = false;
+
+    pthread_mutex_lock(&dir_cache.lock);
+    if (dir_cache.cap) {
+        size_t i = dir_cache_hash(path) & (dir_cache.cap - 1);
+        for (; dir_cache.slots[i]; i = (i + 1) & (dir_cache.cap - 1)) {
+            if (strcmp(dir_cache.slots[i], path) == 0) {
+                found = true;
+                break;
+            }
+        }
+    }
+    pthread_mutex_unlock(&dir_cache.lock);
+    return found;
+}
+
+// path 를 캐시에 넣습니다. 메모리가 없으면 기억하지 않을 뿐입니다.
+static void dir_cache_add(const char *path) {
+    size_t i;
+
+    pthread_mutex_lock(&dir_cache.lock);
+    if ((dir_cache.count + 1) * 2 > dir_cache.cap) {
+        /* 절반 넘게 차면 두 배로 늘려 다시 배치 */
+        size_t ncap = dir_cache.cap ? dir_cache.cap * 2 : DIR_CACHE_INIT_SIZE;
+        char **nslots = calloc(ncap, sizeof(*nslots));
+        if (!nslots) goto out;
+        for (size_t j = 0; j < dir_cache.cap; j++) {
+            if (!dir_cache.slots[j]) continue;
+            i = dir_cache_hash(dir_cache.slots[j]) & (ncap - 1);
+            while (nslots[i]) i = (i + 1) & (ncap - 1);
+            nslots[i] = dir_cache.slots[j];
+        }
+        free(dir_cache.slots);
+        dir_cache.slots = nslots;
+        dir_cache.cap = ncap;
+    }
+    i = dir_cache_hash(path) & (dir_cache.cap - 1);
+    for (; dir_cache.slots[i]; i = (i + 1) & (dir_cache.cap - 1))
+        if (strcmp(dir_cache.slots[i], path) == 0) goto out;
+    if ((dir_cache.slots[i] = strdup(path)) != NULL) dir_cache.count++;
+out:
+    pthread_mutex_unlock(&dir_cache.lock);
+}
+
+void dir_cache_free(void) {
+    for (size_t i = 0; i < dir_cache.cap; i++) free(dir_cache.slots[i]);
+    free(dir_cache.slots);
+    dir_cache.slots = NULL;
+    dir_cache.cap = dir_cache.count = 0;
+}
+
 int mkdirs(const char *dir_path) {
     size_t len = strlen(dir_path) + 1;
-    char *buff = malloc(len);
+    char *buff;
+
+    /* 대부분은 전체 경로가 이미 확인된 경우 */
+    if (dir_cache_has(dir_path)) return 0;
+    buff = malloc(len);
     if (!buff) {
         errno = ENOMEM;
         return -1;
@@ -473,11 +3303,12 @@ int mkdirs(const char *dir_path) {
     while (*p) {
         if (*p == '/') {
             *p = '\0';
-            if (buff[0] != '\0') {
+            if (buff[0] != '\0' && !dir_cache_has(buff)) {
                 if (safe_mkdir(buff, DEFAULT_DIRECTORY_MODE) != 0) {
                     free(buff);
                     return -1;
                 }
+                dir_cache_add(buff);
             }
             *p = '/';
         }
@@ -488,6 +3319,7 @@ int mkdirs(const char *dir_path) {
             free(buff);
             return -1;
         }
+        dir_cache_add(buff);
     }
     free(buff);
     return 0;
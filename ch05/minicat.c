@@ -1,15 +1,106 @@
+#define _GNU_SOURCE   // splice, copy_file_range
 #include <stdio.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/sendfile.h>
 
-#define BUFFSIZE 4096
+#define BUFFSIZE (64 * 1024)
+#define KERNEL_CHUNK (1 << 30)   // splice/sendfile/copy_file_range 1회 요청 크기
+#define PREFETCH_FILES 16        // 출력 중인 파일보다 앞서 열어 둘 최대 파일 수
+#define PREFETCH_THREADS 4       // 미리 여는 스레드 수 (open 지연을 겹치기 위해 여럿)
+#define PREFETCH_BYTES (8 << 20) // 파일마다 WILLNEED 로 미리 읽게 할 앞부분 크기
 
-void cat(int fd) {
-    char buf[PATH_MAX];
+// 표준 출력 종류에 따라 복사 방법을 고름
+enum { OUT_OTHER, OUT_PIPE, OUT_FILE };
+
+int out_kind = OUT_OTHER;
+
+// 파일 인자 여러 개를 순서대로 출력하면서 뒤 파일들을 미리 여는 상태.
+// 작업 스레드가 next 번째 파일을 열고 fadvise 해서 fd[] 에 채우고, main 은 done 번째
+// 파일이 ready 가 되기를 기다려 출력합니다. next - done <= PREFETCH_FILES 라서
+// 열려 있는 fd 수와 미리 읽는 양이 제한됩니다.
+struct prefetch {
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    char **paths;
+    int npaths;
+    int next;     // 다음에 열 파일
+    int done;     // 출력을 마친 파일 수
+    int *fd;      // 열린 fd, 실패면 -1
+    int *err;     // 실패했을 때 errno
+    char *ready;
+};
+
+void cat(int fd);
+int cat_splice(int fd);
+int cat_file(int fd);
+void cat_buffered(int fd);
+int unsupported(int err);
+void cat_path(const char *path);
+void *prefetch_main(void *arg);
+void cat_files(char **paths, int npaths);
+
+// 이 errno 들은 "이 조합에서는 해당 시스템 콜을 쓸 수 없음" 을 뜻하므로 다음 방법으로
+// 넘어감. 세 시스템 콜 모두 오프셋 없이 불러서 fd 위치가 진행한 만큼만 움직이므로,
+// 중간에 넘어가도 이어서 읽으면 됩니다.
+int unsupported(int err) {
+    return err == EINVAL || err == ENOSYS || err == EXDEV || err == EBADF ||
+           err == EOPNOTSUPP || err == ESPIPE;
+}
+
+// 표준 출력이 파이프면 splice 로 페이지를 파이프에 바로 옮김 (사용자 공간 복사 없음)
+int cat_splice(int fd) {
+    ssize_t n;
+
+    while ((n = splice(fd, NULL, STDOUT_FILENO, NULL, KERNEL_CHUNK, SPLICE_F_MOVE)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (unsupported(errno)) return -1;   // 예: 입력이 터미널
+            perror("splice error");
+            exit(1);
+        }
+    }
+    return 0;
+}
+
+// 표준 출력이 일반 파일이면 copy_file_range, 안 되면 sendfile.
+// copy_file_range 는 /proc 같은 크기 0 파일에서 내용이 있어도 0 을 돌려주므로
+// 크기가 있는 일반 파일에만 쓰고, 끝난 뒤에도 sendfile 로 남은 데이터를 확인함
+int cat_file(int fd) {
+    struct stat st;
+    ssize_t n;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        while ((n = copy_file_range(fd, NULL, STDOUT_FILENO, NULL, KERNEL_CHUNK, 0)) != 0) {
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                if (unsupported(errno)) break;   // 예: >> 로 연 O_APPEND 출력
+                perror("copy_file_range error");
+                exit(1);
+            }
+        }
+    }
+    while ((n = sendfile(STDOUT_FILENO, fd, NULL, KERNEL_CHUNK)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (unsupported(errno)) return -1;
+            perror("sendfile error");
+            exit(1);
+        }
+    }
+    return 0;
+}
+
+// 터미널 등: 버퍼로 읽고 씀
+void cat_buffered(int fd) {
+    char buf[BUFFSIZE];
     ssize_t n;
 
-    while ((n = read(fd, buf, PATH_MAX)) > 0) {
+    while ((n = read(fd, buf, BUFFSIZE)) > 0) {
         if (write(STDOUT_FILENO, buf, n) != n) {
             perror("write error");
             exit(1);
@@ -21,22 +112,124 @@ void cat(int fd) {
     }
 }
 
+void cat(int fd) {
+    if (out_kind == OUT_PIPE && cat_splice(fd) == 0)
+        return;
+    if (out_kind == OUT_FILE && cat_file(fd) == 0)
+        return;
+    cat_buffered(fd);   // 빠른 경로를 못 쓰면 그 위치부터 이어서
+}
+
+// 파일 하나를 열어서 출력. 못 열면 알리고 넘어감
+void cat_path(const char *path) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        perror(path);
+        return;   // 에러 발생해도 다음 파일로 진행
+    }
+    cat(fd);
+    close(fd);
+}
+
+// 앞으로 출력할 파일을 열고 앞부분을 미리 읽도록 커널에 알림.
+// 콜드 캐시나 네트워크 파일 시스템에서 open 과 첫 read 의 지연이 출력과 겹칩니다.
+void *prefetch_main(void *arg) {
+    struct prefetch *pf = arg;
+
+    pthread_mutex_lock(&pf->lock);
+    for (;;) {
+        while (pf->next < pf->npaths && pf->next - pf->done >= PREFETCH_FILES)
+            pthread_cond_wait(&pf->cond, &pf->lock);
+        if (pf->next >= pf->npaths)
+            break;
+        int i = pf->next++;
+        pthread_mutex_unlock(&pf->lock);
+
+        struct stat st;
+        int fd = open(pf->paths[i], O_RDONLY), err = errno;
+        if (fd >= 0 && fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+            posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);   // 출력 중 readahead 창 넓히기
+            posix_fadvise(fd, 0, PREFETCH_BYTES, POSIX_FADV_WILLNEED);
+        }
+
+        pthread_mutex_lock(&pf->lock);
+        pf->fd[i] = fd;
+        pf->err[i] = err;
+        pf->ready[i] = 1;
+        pthread_cond_broadcast(&pf->cond);
+    }
+    pthread_mutex_unlock(&pf->lock);
+    return NULL;
+}
+
+// 여러 파일을 인자 순서대로 출력. 스레드를 못 만들면 하나씩 열어서 출력
+void cat_files(char **paths, int npaths) {
+    struct prefetch pf = {.paths = paths, .npaths = npaths};
+    pthread_t tids[PREFETCH_THREADS];
+    int nthreads = 0;
+
+    pf.fd = malloc(npaths * sizeof(*pf.fd));
+    pf.err = malloc(npaths * sizeof(*pf.err));
+    pf.ready = calloc(npaths, 1);
+    if (pf.fd == NULL || pf.err == NULL || pf.ready == NULL) {
+        perror("malloc error");
+        exit(1);
+    }
+    pthread_mutex_init(&pf.lock, NULL);
+    pthread_cond_init(&pf.cond, NULL);
+    while (nthreads < PREFETCH_THREADS && nthreads < npaths &&
+           pthread_create(&tids[nthreads], NULL, prefetch_main, &pf) == 0)
+        nthreads++;
+
+    for (int i = 0; i < npaths; i++) {
+        if (nthreads == 0) {
+            cat_path(paths[i]);
+            continue;
+        }
+        pthread_mutex_lock(&pf.lock);
+        while (!pf.ready[i])
+            pthread_cond_wait(&pf.cond, &pf.lock);
+        pthread_mutex_unlock(&pf.lock);
+
+        if (pf.fd[i] < 0) {
+            errno = pf.err[i];
+            perror(paths[i]);   // 에러 발생해도 다음 파일로 진행
+        } else {
+            cat(pf.fd[i]);
+            close(pf.fd[i]);
+        }
+
+        pthread_mutex_lock(&pf.lock);
+        pf.done = i + 1;   // 한 칸 비었으니 다음 파일을 열게 함
+        pthread_cond_broadcast(&pf.cond);
+        pthread_mutex_unlock(&pf.lock);
+    }
+
+    for (int i = 0; i < nthreads; i++)
+        pthread_join(tids[i], NULL);
+    pthread_cond_destroy(&pf.cond);
+    pthread_mutex_destroy(&pf.lock);
+    free(pf.fd);
+    free(pf.err);
+    free(pf.ready);
+}
+
 int main(int argc, char *argv[]) {
-    int fd;
+    struct stat st;
+
+    if (fstat(STDOUT_FILENO, &st) == 0) {
+        if (S_ISFIFO(st.st_mode)) out_kind = OUT_PIPE;
+        else if (S_ISREG(st.st_mode)) out_kind = OUT_FILE;
+    }
 
     if (argc == 1) {
         // 인자가 없으면 표준 입력 사용
         cat(STDIN_FILENO);
+    } else if (argc == 2) {
+        cat_path(argv[1]);
     } else {
-        for (int i = 1; i < argc; i++) {
-            fd = open(argv[i], O_RDONLY);
-            if (fd < 0) {
-                perror(argv[i]);
-                continue;   // 에러 발생해도 다음 파일로 진행
-            }
-            cat(fd);
-            close(fd);
-        }
+        cat_files(argv + 1, argc - 1);   // 뒤 파일들을 미리 열면서 순서대로 출력
     }
     return 0;
 }
@@ -1,41 +1,665 @@
 #include "apue.h"
+#include <errno.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#define BUFSIZE (1 << 20)      // 읽기/쓰기 버퍼 (1 MiB)
+#define MAX_KEY (1 << 20)      // 키 파일 최대 크기
+#define MIN_PERIOD 4096        // 키를 펼쳐 둘 최소 길이
+#define MAX_JOBS 256
+#define MIN_CHUNK (4 << 20)    // -i -j 에서 스레드 하나가 맡는 최소 크기
+#define CHACHA_BATCH 64        // 한 번에 만드는 ChaCha20 블록 수 (4 KiB, L1 에 머묾)
+#define CHACHA_LIMIT ((uint64_t)1 << 38)   // 32 비트 블록 카운터로 갈 수 있는 끝 (256 GiB)
+#define BENCH_SIZE (64 << 20)  // -b 에서 변환할 메모리 버퍼 크기
+
+// 키를 반복해서 펼쳐 둔 키 스트림.
+// pat[i] = key[i % keylen] 이고 길이는 period + keylen 입니다. period 는 keylen 의
+// 배수라서, 파일 오프셋 off 의 키 바이트부터 period 바이트를 pat + off % keylen 에서
+// 끊김 없이 꺼낼 수 있습니다. 덕분에 XOR 커널은 키 길이와 상관없이 연속된 두
+// 버퍼만 다룹니다.
+struct keystream {
+    unsigned char *pat;
+    size_t keylen;
+    size_t period;
+};
+
+// dst[i] = src[i] ^ ks[i] (dst == src 가능)
+typedef void (*xor_fn)(unsigned char *dst, const unsigned char *src,
+                       const unsigned char *ks, size_t n);
+
+// 상태 in[16] 에서 블록 카운터(in[12])를 하나씩 늘려 가며 ChaCha20 블록 nblocks 개를
+// out 에 씀 (블록당 64 바이트)
+typedef void (*chacha_fn)(const uint32_t in[16], size_t nblocks, unsigned char *out);
+
+// 스트림 암호 백엔드. apply 는 파일 오프셋 off 에서 시작하는 buf[0..n) 을 제자리에서
+// 변환합니다. 키 스트림 위치가 off 만으로 정해지므로 스트리밍이든 -i -j 의 구간
+// 나누기든 같은 함수를 그대로 씁니다.
+struct cipher {
+    const char *name;
+    void (*apply)(const struct cipher *c, unsigned char *buf, size_t n, uint64_t off);
+    xor_fn xor;            // 키 스트림을 데이터에 섞는 커널 (모든 백엔드 공통)
+    struct keystream ks;   // xor: 펼쳐 둔 키
+    uint32_t state[16];    // chacha20: 상수, 키, 블록 카운터(0), nonce
+    chacha_fn block;       // chacha20: 블록 생성 커널
+};
+
+// -c 로 고르는 백엔드 목록. hex_key 면 key 인자를 16진수로 받습니다 (키 파일은 그대로).
+struct cipher_backend {
+    const char *name;
+    int hex_key;
+    void (*setup)(struct cipher *c, const unsigned char *key, size_t keylen);
+};
+
+// -i 에서 스레드 하나가 맡는 구간. off 는 파일 안의 위치라서 여러 바이트 키나
+// ChaCha20 블록도 구간 경계와 상관없이 제자리에 맞습니다.
+struct xor_chunk {
+    pthread_t tid;
+    const struct cipher *c;
+    unsigned char *p;
+    size_t n;
+    uint64_t off;
+};
+
+void xor_scalar(unsigned char *dst, const unsigned char *src, const unsigned char *ks, size_t n);
+xor_fn select_xor(void);
+void chacha_scalar(const uint32_t in[16], size_t nblocks, unsigned char *out);
+chacha_fn select_chacha(void);
+void keystream_init(struct keystream *k, const unsigned char *key, size_t keylen);
+void xor_apply(const struct cipher *c, unsigned char *buf, size_t n, uint64_t off);
+void xor_setup(struct cipher *c, const unsigned char *key, size_t keylen);
+void chacha20_apply(const struct cipher *c, unsigned char *buf, size_t n, uint64_t off);
+void chacha20_setup(struct cipher *c, const unsigned char *key, size_t keylen);
+const struct cipher_backend *find_backend(const char *name);
+size_t parse_hex(const char *s, unsigned char *out, size_t max);
+size_t read_key_file(const char *path, unsigned char *key);
+void *xor_chunk_main(void *arg);
+void transform_in_place(const char *path, const struct cipher *c, int jobs);
+void transform_stream(int fdin, int fdout, const struct cipher *c);
+void write_all(int fd, const unsigned char *buf, size_t n);
+double bench_cipher(const struct cipher *c, unsigned char *buf, size_t n);
+void run_benchmark(const struct cipher_backend *only);
+void print_usage(const char *prog);
+
+void xor_scalar(unsigned char *dst, const unsigned char *src, const unsigned char *ks, size_t n) {
+    size_t i = 0;
+
+    for (; i + 8 <= n; i += 8) {
+        uint64_t a, b;
+        memcpy(&a, src + i, 8);
+        memcpy(&b, ks + i, 8);
+        a ^= b;
+        memcpy(dst + i, &a, 8);
+    }
+    for (; i < n; i++)
+        dst[i] = src[i] ^ ks[i];
+}
+
+#if defined(__x86_64__)
+__attribute__((target("avx2")))
+static void xor_avx2(unsigned char *dst, const unsigned char *src, const unsigned char *ks,
+                     size_t n) {
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i a1 = _mm256_loadu_si256((const __m256i *)(src + i + 32));
+        __m256i k0 = _mm256_loadu_si256((const __m256i *)(ks + i));
+        __m256i k1 = _mm256_loadu_si256((const __m256i *)(ks + i + 32));
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_xor_si256(a0, k0));
+        _mm256_storeu_si256((__m256i *)(dst + i + 32), _mm256_xor_si256(a1, k1));
+    }
+    xor_scalar(dst + i, src + i, ks + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static void xor_avx512(unsigned char *dst, const unsigned char *src, const unsigned char *ks,
+                       size_t n) {
+    size_t i = 0;
+
+    for (; i + 128 <= n; i += 128) {
+        __m512i a0 = _mm512_loadu_si512(src + i);
+        __m512i a1 = _mm512_loadu_si512(src + i + 64);
+        __m512i k0 = _mm512_loadu_si512(ks + i);
+        __m512i k1 = _mm512_loadu_si512(ks + i + 64);
+        _mm512_storeu_si512(dst + i, _mm512_xor_si512(a0, k0));
+        _mm512_storeu_si512(dst + i + 64, _mm512_xor_si512(a1, k1));
+    }
+    xor_scalar(dst + i, src + i, ks + i, n - i);
+}
+#endif
+
+// 실행 중인 CPU 가 지원하는 가장 넓은 XOR 커널을 고름
+xor_fn select_xor(void) {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx512f"))
+        return xor_avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return xor_avx2;
+#endif
+    return xor_scalar;
+}
+
+#define ROTL32(v, c) (((v) << (c)) | ((v) >> (32 - (c))))
+#define QR(a, b, c, d)                        \
+    do {                                       \
+        a += b; d ^= a; d = ROTL32(d, 16);     \
+        c += d; b ^= c; b = ROTL32(b, 12);     \
+        a += b; d ^= a; d = ROTL32(d, 8);      \
+        c += d; b ^= c; b = ROTL32(b, 7);      \
+    } while (0)
+
+// RFC 8439 2.3 의 블록 함수를 그대로 옮긴 기준 구현
+void chacha_scalar(const uint32_t in[16], size_t nblocks, unsigned char *out) {
+    uint32_t x[16], s[16];
+
+    memcpy(s, in, sizeof(s));
+    for (size_t b = 0; b < nblocks; b++, s[12]++) {
+        memcpy(x, s, sizeof(x));
+        for (int r = 0; r < 10; r++) {
+            QR(x[0], x[4], x[8], x[12]);    // 열
+            QR(x[1], x[5], x[9], x[13]);
+            QR(x[2], x[6], x[10], x[14]);
+            QR(x[3], x[7], x[11], x[15]);
+            QR(x[0], x[5], x[10], x[15]);   // 대각선
+            QR(x[1], x[6], x[11], x[12]);
+            QR(x[2], x[7], x[8], x[13]);
+            QR(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++) {   // 리틀 엔디언으로 직렬화
+            uint32_t v = x[i] + s[i];
+            out[64 * b + 4 * i] = (unsigned char)v;
+            out[64 * b + 4 * i + 1] = (unsigned char)(v >> 8);
+            out[64 * b + 4 * i + 2] = (unsigned char)(v >> 16);
+            out[64 * b + 4 * i + 3] = (unsigned char)(v >> 24);
+        }
+    }
+}
+
+#if defined(__x86_64__)
+#define ROTV(v, c) _mm256_or_si256(_mm256_slli_epi32(v, c), _mm256_srli_epi32(v, 32 - (c)))
+#define QRV(a, b, c, d)                                                                  \
+    do {                                                                                  \
+        a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), r16); \
+        c = _mm256_add_epi32(c, d); b = ROTV(_mm256_xor_si256(b, c), 12);                 \
+        a = _mm256_add_epi32(a, b); d = _mm256_shuffle_epi8(_mm256_xor_si256(d, a), r8);  \
+        c = _mm256_add_epi32(c, d); b = ROTV(_mm256_xor_si256(b, c), 7);                  \
+    } while (0)
+
+// v[i] 의 레인 j 가 블록 j 의 i 번째 단어일 때, 8x8 전치해서 블록 j 의 단어 0~7 을
+// out + 64 * j 에 저장
+__attribute__((target("avx2")))
+static inline void transpose8_store(const __m256i v[8], unsigned char *out) {
+    __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]), t1 = _mm256_unpackhi_epi32(v[0], v[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(v[2], v[3]), t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(v[4], v[5]), t5 = _mm256_unpackhi_epi32(v[4], v[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(v[6], v[7]), t7 = _mm256_unpackhi_epi32(v[6], v[7]);
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2), u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3), u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6), u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7), u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    _mm256_storeu_si256((__m256i *)(out + 0 * 64), _mm256_permute2x128_si256(u0, u4, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 1 * 64), _mm256_permute2x128_si256(u1, u5, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 2 * 64), _mm256_permute2x128_si256(u2, u6, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 3 * 64), _mm256_permute2x128_si256(u3, u7, 0x20));
+    _mm256_storeu_si256((__m256i *)(out + 4 * 64), _mm256_permute2x128_si256(u0, u4, 0x31));
+    _mm256_storeu_si256((__m256i *)(out + 5 * 64), _mm256_permute2x128_si256(u1, u5, 0x31));
+    _mm256_storeu_si256((__m256i *)(out + 6 * 64), _mm256_permute2x128_si256(u2, u6, 0x31));
+    _mm256_storeu_si256((__m256i *)(out + 7 * 64), _mm256_permute2x128_si256(u3, u7, 0x31));
+}
+
+// 블록 8 개를 한 번에: 상태 단어 i 를 레지스터 하나에 두고 레인마다 다른 카운터를 씀.
+// 8 개가 안 되는 나머지는 스칼라로
+__attribute__((target("avx2")))
+static void chacha_avx2(const uint32_t in[16], size_t nblocks, unsigned char *out) {
+    const __m256i r16 = _mm256_setr_epi8(2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13,
+                                         2, 3, 0, 1, 6, 7, 4, 5, 10, 11, 8, 9, 14, 15, 12, 13);
+    const __m256i r8 = _mm256_setr_epi8(3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14,
+                                        3, 0, 1, 2, 7, 4, 5, 6, 11, 8, 9, 10, 15, 12, 13, 14);
+    size_t b = 0;
+
+    for (; b + 8 <= nblocks; b += 8) {
+        __m256i s[16], x[16];
+        for (int i = 0; i < 16; i++)
+            s[i] = _mm256_set1_epi32((int)in[i]);
+        s[12] = _mm256_add_epi32(_mm256_set1_epi32((int)(in[12] + b)),
+                                 _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        memcpy(x, s, sizeof(x));
+        for (int r = 0; r < 10; r++) {
+            QRV(x[0], x[4], x[8], x[12]);
+            QRV(x[1], x[5], x[9], x[13]);
+            QRV(x[2], x[6], x[10], x[14]);
+            QRV(x[3], x[7], x[11], x[15]);
+            QRV(x[0], x[5], x[10], x[15]);
+            QRV(x[1], x[6], x[11], x[12]);
+            QRV(x[2], x[7], x[8], x[13]);
+            QRV(x[3], x[4], x[9], x[14]);
+        }
+        for (int i = 0; i < 16; i++)
+            x[i] = _mm256_add_epi32(x[i], s[i]);
+        transpose8_store(x, out + 64 * b);          // 단어 0~7
+        transpose8_store(x + 8, out + 64 * b + 32); // 단어 8~15
+    }
+    if (b < nblocks) {
+        uint32_t t[16];
+        memcpy(t, in, sizeof(t));
+        t[12] += (uint32_t)b;
+        chacha_scalar(t, nblocks - b, out + 64 * b);
+    }
+}
+#endif
+
+chacha_fn select_chacha(void) {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2"))
+        return chacha_avx2;
+#endif
+    return chacha_scalar;
+}
+
+void keystream_init(struct keystream *k, const unsigned char *key, size_t keylen) {
+    k->keylen = keylen;
+    k->period = keylen * ((MIN_PERIOD + keylen - 1) / keylen);
+    if ((k->pat = malloc(k->period + keylen)) == NULL)
+        err_sys("malloc error");
+    for (size_t i = 0; i < k->period + keylen; i++)
+        k->pat[i] = key[i % keylen];
+}
+
+// 파일 오프셋 off 에서 시작하는 buf[0..n) 을 반복 키와 XOR
+void xor_apply(const struct cipher *c, unsigned char *buf, size_t n, uint64_t off) {
+    const struct keystream *k = &c->ks;
+    const unsigned char *ks = k->pat + off % k->keylen;
+
+    while (n > 0) {
+        size_t m = (n < k->period) ? n : k->period;
+        c->xor(buf, buf, ks, m);   // period 는 keylen 의 배수라 다음 조각도 같은 위치에서 시작
+        buf += m;
+        n -= m;
+    }
+}
+
+void xor_setup(struct cipher *c, const unsigned char *key, size_t keylen) {
+    keystream_init(&c->ks, key, keylen);
+    c->apply = xor_apply;
+}
+
+// 오프셋 off 는 블록 off / 64 의 off % 64 번째 바이트. 블록을 CHACHA_BATCH 개씩 만들어
+// 스택 버퍼에 두고 XOR 하므로 스레드마다 따로 불러도 됩니다.
+void chacha20_apply(const struct cipher *c, unsigned char *buf, size_t n, uint64_t off) {
+    unsigned char ks[CHACHA_BATCH * 64];
+    uint32_t st[16];
+    size_t skip = off % 64;
+
+    if (off + n > CHACHA_LIMIT)
+        err_quit("chacha20: input exceeds 256 GiB per key/nonce");
+    memcpy(st, c->state, sizeof(st));
+    st[12] = (uint32_t)(off / 64);
+    while (n > 0) {
+        size_t nblocks = (skip + n + 63) / 64;
+        if (nblocks > CHACHA_BATCH) nblocks = CHACHA_BATCH;
+        c->block(st, nblocks, ks);
+        size_t m = nblocks * 64 - skip;
+        if (m > n) m = n;
+        c->xor(buf, buf, ks + skip, m);
+        buf += m;
+        n -= m;
+        st[12] += (uint32_t)nblocks;
+        skip = 0;
+    }
+}
+
+// 키 32 바이트, 뒤에 12 바이트가 더 있으면 nonce (없으면 0). 블록 카운터는 0 에서 시작
+void chacha20_setup(struct cipher *c, const unsigned char *key, size_t keylen) {
+    static const uint32_t sigma[4] = {0x61707865, 0x3320646e, 0x79622d32, 0x6b206574};
+    unsigned char kn[44] = {0};
+
+    if (keylen != 32 && keylen != 44)
+        err_quit("chacha20: key must be 32 bytes, or 44 bytes with a 12-byte nonce (got %zu)",
+                 keylen);
+    memcpy(kn, key, keylen);
+    memcpy(c->state, sigma, sizeof(sigma));
+    for (int i = 0; i < 8; i++)
+        c->state[4 + i] = (uint32_t)kn[4 * i] | (uint32_t)kn[4 * i + 1] << 8 |
+                          (uint32_t)kn[4 * i + 2] << 16 | (uint32_t)kn[4 * i + 3] << 24;
+    c->state[12] = 0;
+    for (int i = 0; i < 3; i++)
+        c->state[13 + i] = (uint32_t)kn[32 + 4 * i] | (uint32_t)kn[33 + 4 * i] << 8 |
+                           (uint32_t)kn[34 + 4 * i] << 16 | (uint32_t)kn[35 + 4 * i] << 24;
+    c->block = select_chacha();
+    c->apply = chacha20_apply;
+}
+
+static const struct cipher_backend backends[] = {
+    {"xor", 0, xor_setup},
+    {"chacha20", 1, chacha20_setup},
+};
+
+const struct cipher_backend *find_backend(const char *name) {
+    for (size_t i = 0; i < sizeof(backends) / sizeof(backends[0]); i++)
+        if (strcmp(backends[i].name, name) == 0)
+            return &backends[i];
+    return NULL;
+}
+
+// 16진수 문자열을 바이트로. 홀수 길이, 16진수가 아닌 문자, max 초과면 0
+size_t parse_hex(const char *s, unsigned char *out, size_t max) {
+    size_t len = strlen(s);
+
+    if (len % 2 != 0 || len / 2 > max)
+        return 0;
+    for (size_t i = 0; i < len; i++) {
+        int c = s[i], v;
+        if (c >= '0' && c <= '9') v = c - '0';
+        else if (c >= 'a' && c <= 'f') v = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') v = c - 'A' + 10;
+        else return 0;
+        if (i % 2 == 0) out[i / 2] = (unsigned char)(v << 4);
+        else out[i / 2] |= (unsigned char)v;
+    }
+    return len / 2;
+}
+
+// 키 파일 전체(최대 MAX_KEY 바이트)를 키로 사용
+size_t read_key_file(const char *path, unsigned char *key) {
+    size_t len = 0;
+    ssize_t n;
+    int fd;
+
+    if ((fd = open(path, O_RDONLY)) < 0)
+        err_sys("Failed to open key file");
+    while (len < MAX_KEY && (n = read(fd, key + len, MAX_KEY - len)) != 0) {
+        if (n < 0)
+            err_sys("Failed to read key file");
+        len += n;
+    }
+    if (len == MAX_KEY && read(fd, key, 1) > 0)
+        err_quit("key file is larger than %d bytes", MAX_KEY);
+    close(fd);
+    return len;
+}
+
+void *xor_chunk_main(void *arg) {
+    struct xor_chunk *ch = arg;
+
+    ch->c->apply(ch->c, ch->p, ch->n, ch->off);
+    return NULL;
+}
+
+// 파일을 MAP_SHARED 로 mmap 해서 제자리에서 변환. 출력 파일을 따로 쓰지 않으므로
+// 디스크에 사본이 생기지 않고, 페이지 캐시에서 바로 고쳐 씁니다.
+// jobs 개 구간(페이지 경계로 맞춤)으로 나눠 스레드마다 변환합니다.
+void transform_in_place(const char *path, const struct cipher *c, int jobs) {
+    struct xor_chunk chunks[MAX_JOBS];
+    int started[MAX_JOBS];
+    struct stat st;
+    unsigned char *map;
+    int fd;
+
+    if ((fd = open(path, O_RDWR)) < 0)
+        err_sys("Failed to open file");
+    if (fstat(fd, &st) < 0)
+        err_sys("fstat error");
+    if (!S_ISREG(st.st_mode))
+        err_quit("%s: -i needs a regular file", path);
+    if (st.st_size == 0) {
+        close(fd);
+        return;
+    }
+    if ((map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED)
+        err_sys("mmap error");
+    posix_madvise(map, st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    size_t size = st.st_size;
+    if ((size_t)jobs > size / MIN_CHUNK) jobs = size / MIN_CHUNK;
+    if (jobs < 1) jobs = 1;
+    size_t step = (size / jobs + 4095) & ~(size_t)4095;
+    for (int i = 0; i < jobs; i++) {
+        size_t start = (step * i < size) ? step * i : size;
+        size_t end = (i == jobs - 1 || step * (i + 1) > size) ? size : step * (i + 1);
+        chunks[i] = (struct xor_chunk){.c = c, .p = map + start, .n = end - start, .off = start};
+        // 첫 구간은 이 스레드가 직접. 스레드를 못 만들면 그 구간도 직접
+        started[i] = i > 0 && pthread_create(&chunks[i].tid, NULL, xor_chunk_main, &chunks[i]) == 0;
+        if (i > 0 && !started[i]) xor_chunk_main(&chunks[i]);
+    }
+    xor_chunk_main(&chunks[0]);
+    for (int i = 1; i < jobs; i++)
+        if (started[i]) pthread_join(chunks[i].tid, NULL);
+
+    if (munmap(map, st.st_size) < 0)
+        err_sys("munmap error");
+    close(fd);
+}
+
+// 파이프에서는 write 가 요청보다 적게 쓸 수 있으므로 끝까지 씀
+void write_all(int fd, const unsigned char *buf, size_t n) {
+    while (n > 0) {
+        ssize_t w = write(fd, buf, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            err_sys("Write failed");
+        }
+        buf += w;
+        n -= w;
+    }
+}
+
+// 파일을 블록 단위로 읽어서 변환 후 쓰기. lseek 하지 않으므로 파이프에도 씀
+void transform_stream(int fdin, int fdout, const struct cipher *c) {
+    unsigned char *buf;   // 읽기/쓰기 버퍼
+    uint64_t off = 0;
+    ssize_t n;
+
+    if ((buf = malloc(BUFSIZE)) == NULL)
+        err_sys("malloc error");
+    while ((n = read(fdin, buf, BUFSIZE)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            err_sys("Read failed");   // 읽기 중 오류 검사
+        }
+        c->apply(c, buf, n, off);   // 암호 변환
+        off += n;
+        write_all(fdout, buf, n);
+    }
+    free(buf);
+}
+
+// 메모리 버퍼 n 바이트를 0.5 초 넘게 반복 변환해서 GB/s 를 구함
+double bench_cipher(const struct cipher *c, unsigned char *buf, size_t n) {
+    struct timespec t0, t1;
+    uint64_t done = 0;
+    double sec;
+
+    c->apply(c, buf, n, 0);   // 페이지 폴트와 캐시 예열
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    do {
+        c->apply(c, buf, n, 0);
+        done += n;
+        clock_gettime(CLOCK_MONOTONIC, &t1);
+        sec = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    } while (sec < 0.5);
+    return done / sec / 1e9;
+}
+
+// 백엔드마다 이 CPU 에서 쓸 수 있는 커널을 하나씩 바꿔 가며 처리량을 출력.
+// xor 는 XOR 커널을, chacha20 은 블록 커널을 바꾸고 XOR 은 가장 넓은 것을 씀
+void run_benchmark(const struct cipher_backend *only) {
+    struct { const char *name; xor_fn fn; } xors[3];
+    struct { const char *name; chacha_fn fn; } blocks[2];
+    int nx = 0, nb = 0;
+    unsigned char key[32], *buf;
+
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx512f")) {
+        xors[nx].name = "avx512";
+        xors[nx++].fn = xor_avx512;
+    }
+    if (__builtin_cpu_supports("avx2")) {
+        xors[nx].name = "avx2";
+        xors[nx++].fn = xor_avx2;
+        blocks[nb].name = "avx2";
+        blocks[nb++].fn = chacha_avx2;
+    }
+#endif
+    xors[nx].name = "scalar";
+    xors[nx++].fn = xor_scalar;
+    blocks[nb].name = "scalar";
+    blocks[nb++].fn = chacha_scalar;
+
+    for (int i = 0; i < 32; i++)
+        key[i] = (unsigned char)(i * 7 + 1);
+    if ((buf = malloc(BENCH_SIZE)) == NULL)
+        err_sys("malloc error");
+    memset(buf, 0x5a, BENCH_SIZE);
+
+    printf("%-9s %-7s %8s\n", "backend", "kernel", "GB/s");
+    for (size_t b = 0; b < sizeof(backends) / sizeof(backends[0]); b++) {
+        struct cipher c = {.name = backends[b].name, .xor = select_xor()};
+        if (only && only != &backends[b])
+            continue;
+        backends[b].setup(&c, key, sizeof(key));
+        if (c.block == NULL) {
+            for (int k = 0; k < nx; k++) {
+                c.xor = xors[k].fn;
+                printf("%-9s %-7s %8.2f\n", c.name, xors[k].name, bench_cipher(&c, buf, BENCH_SIZE));
+            }
+        } else {
+            for (int k = 0; k < nb; k++) {
+                c.block = blocks[k].fn;
+                printf("%-9s %-7s %8.2f\n", c.name, blocks[k].name, bench_cipher(&c, buf, BENCH_SIZE));
+            }
+        }
+        fflush(stdout);
+        free(c.ks.pat);
+    }
+    free(buf);
+}
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-c cipher] [-f <keyfile>] <key> <input> <output>\n", prog);
+    fprintf(stderr, "       %s [-c cipher] [-f <keyfile>] -i [-j N] <key> <file>\n", prog);
+    fprintf(stderr, "       %s [-c cipher] -b\n", prog);
+    fprintf(stderr, "  -c cipher     xor(기본) 또는 chacha20\n");
+    fprintf(stderr, "  -f <keyfile>  key 인자 대신 키 파일 내용을 키로 사용\n");
+    fprintf(stderr, "  -i            file 을 mmap 해서 제자리에서 변환\n");
+    fprintf(stderr, "  -j N          -i 에서 N 개 스레드로 나눠 변환\n");
+    fprintf(stderr, "  -b            메모리에서 백엔드/커널별 처리량(GB/s) 측정\n");
+    fprintf(stderr, "  input/output 이 - 이면 표준 입력/출력\n");
+    fprintf(stderr, "  chacha20 키는 16진수 64 자리(32 바이트), 24 자리를 더 붙이면 nonce(12 바이트).\n");
+    fprintf(stderr, "  키 파일이면 32 또는 44 바이트 그대로. 같은 키와 nonce 를 다른 파일에 다시 쓰지 말 것\n");
+}
 
 int main(int argc, char *argv[]) {
-    if (argc != 4) {
-        fprintf(stderr, "Usage: %s <key> <input> <output>\n", argv[0]); 
+    const struct cipher_backend *backend = &backends[0], *only = NULL;
+    const char *keyfile = NULL;
+    int in_place = 0, jobs = 1, bench = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "bc:f:ij:")) != -1) {
+        switch (opt) {
+            case 'b':
+                bench = 1;
+                break;
+            case 'c':
+                if ((backend = only = find_backend(optarg)) == NULL) {
+                    fprintf(stderr, "-c: unknown cipher '%s' (xor, chacha20)\n", optarg);
+                    exit(1);
+                }
+                break;
+            case 'f':
+                keyfile = optarg;
+                break;
+            case 'i':
+                in_place = 1;
+                break;
+            case 'j': {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n < 1 || n > MAX_JOBS) {
+                    fprintf(stderr, "-j: thread count must be 1..%d\n", MAX_JOBS);
+                    exit(1);
+                }
+                jobs = (int)n;
+                break;
+            }
+            default:
+                print_usage(argv[0]);
+                exit(1);
+        }
+    }
+    if (bench) {
+        if (argc != optind) {
+            print_usage(argv[0]);
+            exit(1);
+        }
+        run_benchmark(only);   // -c 가 없으면 모든 백엔드
+        return 0;
+    }
+    // 키 인자(키 파일이 없을 때) + 파일 2 개, -i 면 파일 1 개
+    if (argc - optind != (keyfile ? 0 : 1) + (in_place ? 1 : 2)) {
+        print_usage(argv[0]);
         exit(1);
     }
-    unsigned char key = (unsigned char)argv[1][0]; // 첫 문자를 키로 사용
-    int fdin, fdout;
-    char buf[4096]; // 읽기/쓰기 버퍼
-    ssize_t n;
+
+    // 키: 인자 문자열 전체(hex_key 백엔드는 16진수를 푼 바이트) 또는 키 파일 전체
+    static unsigned char keybuf[MAX_KEY];
+    const unsigned char *key = keybuf;
+    size_t keylen;
+    if (keyfile) {
+        keylen = read_key_file(keyfile, keybuf);
+    } else if (backend->hex_key) {
+        if ((keylen = parse_hex(argv[optind], keybuf, MAX_KEY)) == 0)
+            err_quit("%s: key must be an even number of hex digits", backend->name);
+    } else {
+        key = (const unsigned char *)argv[optind];
+        keylen = strlen(argv[optind]);
+    }
+    if (keylen == 0)
+        err_quit("key must not be empty");
+
+    // XOR 커널은 AVX-512 / AVX2 / 스칼라 중 실행 시점에 선택
+    struct cipher c = {.name = backend->name, .xor = select_xor()};
+    backend->setup(&c, key, keylen);
+
+    if (in_place) {
+        const char *path = argv[argc - 1];
+        transform_in_place(path, &c, jobs);
+        free(c.ks.pat);
+        printf("File transformed in place: %s (%s, key=%zu bytes)\n", path, c.name, keylen);
+        return 0;
+    }
+
+    const char *in_path = argv[argc - 2], *out_path = argv[argc - 1];
+    int fdin = STDIN_FILENO, fdout = STDOUT_FILENO;
 
     // 입력 파일 열기
-    if ((fdin = open(argv[2], O_RDONLY)) < 0)
+    if (strcmp(in_path, "-") != 0 && (fdin = open(in_path, O_RDONLY)) < 0)
         err_sys("Failed to open input file");
 
     // 출력 파일 열기(없으면 생성, 있으면 덮어쓰기)
-    if ((fdout = open(argv[3], O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
+    if (strcmp(out_path, "-") != 0 &&
+        (fdout = open(out_path, O_WRONLY | O_CREAT | O_TRUNC, 0666)) < 0)
         err_sys("Failed to open output file");
 
-    // 파일을 블록 단위로 읽어서 XOR 변환 후 쓰기
-    while ((n = read(fdin, buf, sizeof(buf))) > 0) {
-        for (ssize_t i = 0; i < n; i++)
-            buf[i] ^= key;   // XOR 변환
-        if (write(fdout, buf, n) != n)
-            err_sys("Write failed");
-    }
-    // 읽기 중 오류 검사
-    if (n < 0)
-        err_sys("Read failed");
+    transform_stream(fdin, fdout, &c);
 
     // 파일 디스크립터 닫기
-    close(fdin);
-    close(fdout);
+    if (fdin != STDIN_FILENO) close(fdin);
+    if (fdout != STDOUT_FILENO && close(fdout) < 0)
+        err_sys("close error");
+    free(c.ks.pat);
 
-    printf("File transformed: %s -> %s (key=%c)\n", argv[2], argv[3], key);
+    // 표준 출력으로 데이터를 내보낼 때는 요약을 표준 에러로
+    fprintf(fdout == STDOUT_FILENO ? stderr : stdout,
+            "File transformed: %s -> %s (%s, key=%zu bytes)\n", in_path, out_path, c.name, keylen);
     return 0;
 }
 
@@ -44,3 +668,16 @@ int main(int argc, char *argv[]) {
 // ./xorcrypt K plain.txt enc.txt
 // ./xorcrypt K enc.txt dec.txt
 // diff plain.txt dec.txt   # 차이가 없어야 성공
+//
+// 여러 바이트 키나 키 파일도 같은 방식:
+// ./xorcrypt 'my secret' plain.txt enc.txt
+// head -c 4096 /dev/urandom > key.bin; ./xorcrypt -f key.bin plain.txt enc.txt
+//
+// 제자리 변환과 파이프:
+// ./xorcrypt -i -j 8 'my secret' big.bin
+// zcat logs.gz | ./xorcrypt 'my secret' - - | gzip > logs.enc.gz
+//
+// ChaCha20 (RFC 8439) 백엔드와 처리량 비교:
+// head -c 44 /dev/urandom > cc.key; ./xorcrypt -c chacha20 -f cc.key plain.txt enc.txt
+// ./xorcrypt -c chacha20 $(head -c 32 /dev/urandom | xxd -p -c 64) plain.txt enc.txt
+// ./xorcrypt -b
@@ -1,54 +1,809 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
 
-#define BUFFSIZE 4096
+#define BUFFSIZE (1 << 20)   // mmap 할 수 없는 입력(파이프 등)을 읽을 블록 크기
+#define MAX_JOBS 256
+#define MIN_CHUNK (4 << 20)  // -j 로 나눌 때 구간 하나의 최소 크기
+#define ANALYZE_BLOCK (256 << 10)  // -L/-H/-t 에서 세기와 분석을 번갈아 돌리는 단위 (L2 크기)
+#define ARENA_BLOCK (1 << 20)
+#define WORD_TABLE_INIT 4096 // 단어 표의 처음 칸 수 (2 의 거듭제곱)
+#define MAX_WORD 256         // -t 에서 단어를 구분하는 최대 길이, 더 긴 단어는 앞부분으로 셈
+#define MAX_TOP 1000000
 
-int main(int argc, char *argv[]) {    
-    FILE *fp = NULL;
-    if (argc < 2) {
-        fprintf(stderr, "Usage: %s <filename>\n", argv[0]);
-        return 2;
+// 한 번 훑으면서 세는 값들
+struct wc_counts {
+    unsigned long long lines;
+    unsigned long long words;
+    unsigned long long chars;   // UTF-8 문자 수 (-m 일 때만 출력)
+    unsigned long long bytes;
+};
+
+// 블록 사이로 넘겨주는 상태. 블록 경계에 걸친 단어나 UTF-8 시퀀스를
+// 두 번 세거나 잘못 해석하지 않도록 다음 블록으로 이어 받습니다.
+struct wc_state {
+    int in_space;   // 직전 글자가 구분자였는지
+    int need;       // 진행 중인 멀티바이트 시퀀스에 남은 연속 바이트 수
+    uint32_t cp;    // 지금까지 모은 코드 포인트
+};
+
+// 블록 하나를 세는 함수
+typedef void (*count_fn)(const unsigned char *p, size_t n, struct wc_state *st,
+                         struct wc_counts *c);
+
+// -t 단어 표의 키를 담는 arena. 단어마다 malloc 하지 않고 큰 블록에서 잘라 쓰고
+// 표를 버릴 때 블록째 해제합니다.
+struct arena_block {
+    struct arena_block *next;
+    size_t used;
+    char data[ARENA_BLOCK];
+};
+
+// 단어 -> 빈도 open addressing(선형 탐사) 해시 표. key 가 NULL 이면 빈 칸
+struct word_entry {
+    uint64_t hash;
+    const char *key;
+    uint32_t len;
+    unsigned long long count;
+};
+
+struct word_table {
+    struct word_entry *slots;
+    size_t cap;    // 2 의 거듭제곱
+    size_t used;
+    struct arena_block *arena;
+};
+
+// -L, -H, -t 분석 결과. 구간/입력마다 하나씩 두고 끝나면 합칩니다.
+struct wc_extra {
+    unsigned long long max_line;      // 가장 긴 줄의 바이트 수 ('\n' 제외)
+    unsigned long long cur_line;      // 아직 끝나지 않은 줄의 길이
+    unsigned long long hist[4][256];  // 바이트 값 빈도, 4 개 표에 번갈아 더함
+    struct word_table words;
+    unsigned char word[MAX_WORD];     // 블록 경계에 걸친 단어를 모으는 곳
+    size_t word_len;
+    size_t seq_start;                 // 진행 중인 UTF-8 시퀀스가 word 의 어디서 시작했는지
+    int need;
+    uint32_t cp;
+};
+
+// -j 에서 스레드 하나가 맡는 바이트 구간
+struct chunk {
+    pthread_t tid;
+    const unsigned char *p;
+    size_t n;
+    struct wc_state st;
+    count_fn count;
+    struct wc_counts c;
+    struct wc_extra *e;
+};
+
+// 입력 하나(파일 또는 "-" 인 표준 입력)의 결과
+struct wc_file {
+    const char *name;
+    struct wc_counts c;
+    struct wc_extra *e;
+    int state;   // 0: 아직, 1: 완료, -1: 실패
+};
+
+// 여러 입력을 동시에 세는 고정 크기 스레드 풀. 작업자는 next 로 다음 입력을
+// 가져가고, main 은 인자 순서대로 완료를 기다리며 결과를 바로 출력합니다.
+struct wc_pool {
+    struct wc_file *files;
+    int nfiles;
+    int next;
+    int nchunks;   // 입력 하나를 몇 구간으로 나눠 셀지 (입력이 하나일 때만 jobs_opt)
+    count_fn count;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+};
+
+int chars_opt = 0;  // -m: UTF-8 문자 수도 출력
+int longest_opt = 0; // -L: 가장 긴 줄의 길이
+int hist_opt = 0;    // -H: 바이트 값 히스토그램
+int top_opt = 0;     // -t N: 가장 많이 나온 단어 N 개
+int extra_on = 0;    // -L, -H, -t 중 하나라도 켜졌는지
+int jobs_opt = 1;   // -j N: 입력 N 개를 동시에, 입력이 하나면 N 개 구간으로 나눠 셈
+
+void count_scalar(const unsigned char *p, size_t n, struct wc_state *st, struct wc_counts *c);
+count_fn select_kernel(void);
+void *count_chunk_main(void *arg);
+void *arena_alloc(struct arena_block **arena, size_t n);
+void word_table_add(struct word_table *t, const char *key, size_t len, uint64_t hash,
+                    unsigned long long n);
+void word_table_free(struct word_table *t);
+struct wc_extra *extra_new(void);
+void extra_free(struct wc_extra *e);
+void extra_merge(struct wc_extra *dst, const struct wc_extra *src);
+void extra_finish(struct wc_extra *e);
+void analyze(const unsigned char *p, size_t n, struct wc_extra *e);
+void count_block(count_fn count, const unsigned char *p, size_t n, struct wc_state *st,
+                 struct wc_counts *c, struct wc_extra *e);
+void count_parallel(const unsigned char *p, size_t n, int nchunks, count_fn count,
+                    struct wc_counts *c, struct wc_extra *e);
+int count_fd(int fd, const char *name, int nchunks, count_fn count, struct wc_counts *c,
+             struct wc_extra *e);
+int count_file(struct wc_pool *pool, struct wc_file *f);
+void *pool_worker_main(void *arg);
+void print_counts(const struct wc_counts *c, const struct wc_extra *e, const char *name);
+void print_extra(struct wc_extra *e);
+void print_usage(const char *prog);
+
+// 단어 구분자는 GNU wc 9.1 (LC_ALL=C.UTF-8) 과 같게 glibc iswspace 에 줄바꿈을 막는
+// 공백(U+00A0, U+2007, U+202F)을 더한 것입니다. U+0085, U+2028, U+2029 는 iswspace 가
+// 공백으로 보지 않으므로 단어를 나누지 않습니다. ASCII 는 \t \n \v \f \r 과 ' '.
+// 다만 GNU wc 는 인쇄할 수 없는 글자만으로 된 단어를 세지 않지만 여기서는 공백이
+// 아닌 글자는 모두 단어로 셉니다.
+static inline int is_ascii_space(unsigned char ch) {
+    return ch == ' ' || (ch >= '\t' && ch <= '\r');
+}
+
+static inline int is_unicode_space(uint32_t cp) {
+    return cp == 0xa0 || cp == 0x1680 || (cp >= 0x2000 && cp <= 0x200a) || cp == 0x202f ||
+           cp == 0x205f || cp == 0x3000;
+}
+
+// UTF-8 를 한 바이트씩 디코드하며 셈. 문자 수는 연속 바이트(10xxxxxx)가 아닌
+// 바이트의 수이고, 단어는 멀티바이트 글자가 끝난 시점에 그 글자가 공백인지로 판단.
+// 잘못된 바이트와 중간에 끊긴 시퀀스는 공백이 아닌 글자로 취급합니다.
+void count_scalar(const unsigned char *p, size_t n, struct wc_state *st, struct wc_counts *c) {
+    int sp = st->in_space, need = st->need;
+    uint32_t cp = st->cp;
+
+    for (size_t i = 0; i < n; i++) {
+        unsigned char b = p[i];
+        int s;
+
+        c->lines += (b == '\n');
+        c->chars += ((b & 0xc0) != 0x80);
+        if (need > 0) {
+            if ((b & 0xc0) == 0x80) {
+                cp = (cp << 6) | (b & 0x3f);
+                if (--need > 0) continue;
+                s = is_unicode_space(cp);
+                c->words += sp & !s;   // 구분자 -> 비구분자 전이가 단어의 시작
+                sp = s;
+                continue;
+            }
+            need = 0;          // 끊긴 시퀀스는 공백 아닌 글자 하나
+            c->words += sp;
+            sp = 0;
+        }
+        if (b < 0x80) {
+            s = is_ascii_space(b);
+        } else if (b >= 0xc2 && b <= 0xf4) {
+            need = (b >= 0xf0) ? 3 : (b >= 0xe0) ? 2 : 1;
+            cp = b & (0x3f >> need);
+            continue;
+        } else {
+            s = 0;             // 홀로 나온 연속 바이트, 0xc0/0xc1/0xf5.. 등
+        }
+        c->words += sp & !s;
+        sp = s;
     }
-    fp = fopen(argv[1], "r");
-    if (!fp) {
-        perror("fopen");
-        return 1;
+    st->in_space = sp;
+    st->need = need;
+    st->cp = cp;
+    c->bytes += n;
+}
+
+#if defined(__x86_64__)
+// 64 바이트마다 "개행", "구분자", "연속 바이트" 비트마스크를 만들고
+//   lines += popcount(nl)
+//   words += popcount(~sp & (sp << 1 | 직전 블록의 마지막 비트))
+//   chars += 64 - popcount(cont)
+// 로 셉니다. 바이트마다 분기하지 않으므로 메모리 대역폭에 가까운 속도가 나옵니다.
+//
+// 멀티바이트 공백은 모두 0xc2, 0xe1, 0xe2, 0xe3 으로 시작하므로, 이 바이트가 없고
+// 이전 블록에서 이어지는 시퀀스도 없는 블록은 한글처럼 ASCII 가 아닌 글자가
+// 섞여 있어도 ASCII 공백만 보면 됩니다. 나머지 블록만 count_scalar 로 디코드합니다.
+static inline void count_masks(uint64_t nl, uint64_t sp, uint64_t cont,
+                               struct wc_state *st, struct wc_counts *c) {
+    c->lines += __builtin_popcountll(nl);
+    c->words += __builtin_popcountll(~sp & ((sp << 1) | (uint64_t)st->in_space));
+    c->chars += 64 - __builtin_popcountll(cont);
+    c->bytes += 64;
+    st->in_space = sp >> 63;
+}
+
+__attribute__((target("sse2,popcnt")))
+static void count_sse2(const unsigned char *p, size_t n, struct wc_state *st,
+                       struct wc_counts *c) {
+    const __m128i vnl = _mm_set1_epi8('\n');
+    const __m128i vsp = _mm_set1_epi8(' ');
+    const __m128i vtab_lo = _mm_set1_epi8('\t' - 1);
+    const __m128i vcr_hi = _mm_set1_epi8('\r' + 1);
+    const __m128i vcont_hi = _mm_set1_epi8((char)0xc0);
+    const __m128i vc2 = _mm_set1_epi8((char)0xc2);
+    const __m128i ve1_lo = _mm_set1_epi8((char)0xe0);
+    const __m128i ve3_hi = _mm_set1_epi8((char)0xe4);
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        uint64_t nl = 0, sp = 0, cont = 0, lead = 0;
+        for (int k = 0; k < 4; k++) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(p + i + k * 16));
+            // 부호 있는 비교라 0x80 이상은 음수: 0x09..0x0d 비교에서 자연히 빠지고,
+            // 0x80..0xbf 는 0xc0 보다 작은 값, 0xe1..0xe3 은 0xe0 와 0xe4 사이
+            __m128i is_nl = _mm_cmpeq_epi8(v, vnl);
+            __m128i is_sp = _mm_or_si128(_mm_cmpeq_epi8(v, vsp),
+                                         _mm_and_si128(_mm_cmpgt_epi8(v, vtab_lo),
+                                                       _mm_cmpgt_epi8(vcr_hi, v)));
+            __m128i is_cont = _mm_cmpgt_epi8(vcont_hi, v);
+            __m128i is_lead = _mm_or_si128(_mm_cmpeq_epi8(v, vc2),
+                                           _mm_and_si128(_mm_cmpgt_epi8(v, ve1_lo),
+                                                         _mm_cmpgt_epi8(ve3_hi, v)));
+            nl |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_nl) << (k * 16);
+            sp |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_sp) << (k * 16);
+            cont |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_cont) << (k * 16);
+            lead |= (uint64_t)(uint16_t)_mm_movemask_epi8(is_lead) << (k * 16);
+        }
+        if (st->need == 0 && lead == 0)
+            count_masks(nl, sp, cont, st, c);
+        else
+            count_scalar(p + i, 64, st, c);
+    }
+    count_scalar(p + i, n - i, st, c);   // 64 바이트 미만 꼬리
+}
+
+__attribute__((target("avx2,popcnt")))
+static inline uint64_t mask64(__m256i lo, __m256i hi) {
+    return (uint32_t)_mm256_movemask_epi8(lo) |
+           (uint64_t)(uint32_t)_mm256_movemask_epi8(hi) << 32;
+}
+
+__attribute__((target("avx2,popcnt")))
+static void count_avx2(const unsigned char *p, size_t n, struct wc_state *st,
+                       struct wc_counts *c) {
+    const __m256i vnl = _mm256_set1_epi8('\n');
+    const __m256i vsp = _mm256_set1_epi8(' ');
+    const __m256i vtab_lo = _mm256_set1_epi8('\t' - 1);
+    const __m256i vcr_hi = _mm256_set1_epi8('\r' + 1);
+    const __m256i vcont_hi = _mm256_set1_epi8((char)0xc0);
+    const __m256i vc2 = _mm256_set1_epi8((char)0xc2);
+    const __m256i ve1_lo = _mm256_set1_epi8((char)0xe0);
+    const __m256i ve3_hi = _mm256_set1_epi8((char)0xe4);
+    size_t i = 0;
+
+    for (; i + 64 <= n; i += 64) {
+        __m256i v[2], nl[2], sp[2], cont[2], lead[2];
+        v[0] = _mm256_loadu_si256((const __m256i *)(p + i));
+        v[1] = _mm256_loadu_si256((const __m256i *)(p + i + 32));
+        for (int k = 0; k < 2; k++) {
+            nl[k] = _mm256_cmpeq_epi8(v[k], vnl);
+            sp[k] = _mm256_or_si256(_mm256_cmpeq_epi8(v[k], vsp),
+                                    _mm256_and_si256(_mm256_cmpgt_epi8(v[k], vtab_lo),
+                                                     _mm256_cmpgt_epi8(vcr_hi, v[k])));
+            cont[k] = _mm256_cmpgt_epi8(vcont_hi, v[k]);
+            lead[k] = _mm256_or_si256(_mm256_cmpeq_epi8(v[k], vc2),
+                                      _mm256_and_si256(_mm256_cmpgt_epi8(v[k], ve1_lo),
+                                                       _mm256_cmpgt_epi8(ve3_hi, v[k])));
+        }
+        if (st->need == 0 && mask64(lead[0], lead[1]) == 0)
+            count_masks(mask64(nl[0], nl[1]), mask64(sp[0], sp[1]),
+                        mask64(cont[0], cont[1]), st, c);
+        else
+            count_scalar(p + i, 64, st, c);
+    }
+    count_scalar(p + i, n - i, st, c);
+}
+#endif
+
+// 실행 중인 CPU 가 지원하는 가장 넓은 커널을 고름
+count_fn select_kernel(void) {
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt"))
+        return count_avx2;
+    if (__builtin_cpu_supports("popcnt"))
+        return count_sse2;
+#endif
+    return count_scalar;
+}
+
+// ---- -L / -H / -t 분석 ----
+
+void *arena_alloc(struct arena_block **arena, size_t n) {
+    struct arena_block *b = *arena;
+
+    if (!b || b->used + n > ARENA_BLOCK) {
+        b = malloc(sizeof(*b));
+        if (!b) {
+            perror("malloc");
+            exit(1);
+        }
+        b->next = *arena;
+        b->used = 0;
+        *arena = b;
+    }
+    b->used += n;
+    return b->data + b->used - n;
+}
+
+static uint64_t fnv1a(const unsigned char *p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+
+    for (size_t i = 0; i < n; i++) h = (h ^ p[i]) * 0x100000001b3ULL;
+    return h;
+}
+
+// 찾으면 빈도에 n 을 더하고, 없으면 키를 arena 에 복사해 새로 넣음.
+// 70% 넘게 차면 두 배로 늘려 다시 넣음 (키는 arena 에 그대로 있음)
+void word_table_add(struct word_table *t, const char *key, size_t len, uint64_t hash,
+                    unsigned long long n) {
+    if ((t->used + 1) * 10 > t->cap * 7) {
+        size_t cap = t->cap ? t->cap * 2 : WORD_TABLE_INIT;
+        struct word_entry *slots = calloc(cap, sizeof(*slots));
+        if (!slots) {
+            perror("calloc");
+            exit(1);
+        }
+        for (size_t i = 0; i < t->cap; i++) {
+            if (!t->slots[i].key) continue;
+            size_t j = t->slots[i].hash & (cap - 1);
+            while (slots[j].key) j = (j + 1) & (cap - 1);
+            slots[j] = t->slots[i];
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->cap = cap;
+    }
+
+    size_t i = hash & (t->cap - 1);
+    while (t->slots[i].key) {
+        struct word_entry *w = &t->slots[i];
+        if (w->hash == hash && w->len == len && memcmp(w->key, key, len) == 0) {
+            w->count += n;
+            return;
+        }
+        i = (i + 1) & (t->cap - 1);
+    }
+    char *copy = arena_alloc(&t->arena, len);
+    memcpy(copy, key, len);
+    t->slots[i] = (struct word_entry){hash, copy, (uint32_t)len, n};
+    t->used++;
+}
+
+void word_table_free(struct word_table *t) {
+    while (t->arena) {
+        struct arena_block *next = t->arena->next;
+        free(t->arena);
+        t->arena = next;
+    }
+    free(t->slots);
+    memset(t, 0, sizeof(*t));
+}
+
+struct wc_extra *extra_new(void) {
+    struct wc_extra *e = calloc(1, sizeof(*e));
+    if (!e) {
+        perror("calloc");
+        exit(1);
+    }
+    return e;
+}
+
+void extra_free(struct wc_extra *e) {
+    if (!e) return;
+    word_table_free(&e->words);
+    free(e);
+}
+
+void extra_merge(struct wc_extra *dst, const struct wc_extra *src) {
+    if (src->max_line > dst->max_line) dst->max_line = src->max_line;
+    for (int k = 0; k < 4; k++)
+        for (int b = 0; b < 256; b++) dst->hist[k][b] += src->hist[k][b];
+    for (size_t i = 0; i < src->words.cap; i++) {
+        const struct word_entry *w = &src->words.slots[i];
+        if (w->key) word_table_add(&dst->words, w->key, w->len, w->hash, w->count);
     }
+}
 
-    // 라인 단위 읽기 (fgets)
-    int line_count = 0;
-    char linebuf[PATH_MAX];
-    while (fgets(linebuf, sizeof(linebuf), fp)) {
-        line_count++;
-    }
-    
-    rewind(fp); // 파일 처음으로 이동    
-
-    // 파일 길이 구하기 (fseek, ftell))
-    fseek(fp, 0, SEEK_END);
-    long filesize = ftell(fp);
-    
-    rewind(fp);
-
-    // 문자/단어 단위 읽기 (fgetc)
-    int word_count = 0;
-    int c;
-    int in_word = 0;
-    while ((c = fgetc(fp)) != EOF) {
-        if (c == ' ' || c == '\n' || c == '\t') {
-            in_word = 0;
+static void word_end(struct wc_extra *e) {
+    if (e->word_len == 0) return;
+    word_table_add(&e->words, (const char *)e->word, e->word_len,
+                   fnv1a(e->word, e->word_len), 1);
+    e->word_len = 0;
+}
+
+static inline void word_push(struct wc_extra *e, unsigned char b) {
+    if (e->word_len < MAX_WORD) e->word[e->word_len++] = b;
+}
+
+// 입력 끝: 끝나지 않은 마지막 줄과 단어를 반영
+void extra_finish(struct wc_extra *e) {
+    if (e->cur_line > e->max_line) e->max_line = e->cur_line;
+    e->cur_line = 0;
+    e->need = 0;
+    word_end(e);
+}
+
+// count_scalar 와 같은 규칙으로 단어를 잘라 표에 넣음. 멀티바이트 글자는 일단
+// 단어에 붙여 두고, 끝났을 때 공백이면 그 바이트들을 떼어내고 단어를 끝냄
+static void scan_words(const unsigned char *p, size_t n, struct wc_extra *e) {
+    for (size_t i = 0; i < n; i++) {
+        unsigned char b = p[i];
+
+        if (e->need > 0) {
+            if ((b & 0xc0) == 0x80) {
+                e->cp = (e->cp << 6) | (b & 0x3f);
+                word_push(e, b);
+                if (--e->need == 0 && is_unicode_space(e->cp)) {
+                    e->word_len = e->seq_start;
+                    word_end(e);
+                }
+                continue;
+            }
+            e->need = 0;   // 끊긴 시퀀스는 단어의 일부로 둠
+        }
+        if (b < 0x80) {
+            if (is_ascii_space(b))
+                word_end(e);
+            else
+                word_push(e, b);
         } else {
-            if (!in_word) {
-                word_count++;
-                in_word = 1;
+            if (b >= 0xc2 && b <= 0xf4) {
+                e->need = (b >= 0xf0) ? 3 : (b >= 0xe0) ? 2 : 1;
+                e->cp = b & (0x3f >> e->need);
+                e->seq_start = e->word_len;
             }
+            word_push(e, b);
         }
     }
+}
+
+void analyze(const unsigned char *p, size_t n, struct wc_extra *e) {
+    if (hist_opt) {
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            e->hist[0][p[i]]++;
+            e->hist[1][p[i + 1]]++;
+            e->hist[2][p[i + 2]]++;
+            e->hist[3][p[i + 3]]++;
+        }
+        for (; i < n; i++) e->hist[0][p[i]]++;
+    }
+    if (longest_opt) {
+        const unsigned char *q = p, *end = p + n, *nl;
+        while ((nl = memchr(q, '\n', end - q)) != NULL) {
+            unsigned long long len = e->cur_line + (nl - q);
+            if (len > e->max_line) e->max_line = len;
+            e->cur_line = 0;
+            q = nl + 1;
+        }
+        e->cur_line += end - q;
+    }
+    if (top_opt) scan_words(p, n, e);
+}
+
+// 분석이 켜져 있으면 블록을 L2 에 들어가는 크기로 잘라 세기와 분석을 번갈아
+// 돌립니다. 분석은 방금 센 바이트를 캐시에서 다시 읽으므로 입력은 한 번만 훑습니다.
+void count_block(count_fn count, const unsigned char *p, size_t n, struct wc_state *st,
+                 struct wc_counts *c, struct wc_extra *e) {
+    if (!e) {
+        count(p, n, st, c);
+        return;
+    }
+    for (size_t off = 0; off < n; off += ANALYZE_BLOCK) {
+        size_t m = (n - off < ANALYZE_BLOCK) ? n - off : ANALYZE_BLOCK;
+        count(p + off, m, st, c);
+        analyze(p + off, m, e);
+    }
+}
+
+void *count_chunk_main(void *arg) {
+    struct chunk *ch = arg;
+
+    count_block(ch->count, ch->p, ch->n, &ch->st, &ch->c, ch->e);
+    if (ch->e) extra_finish(ch->e);
+    return NULL;
+}
+
+// [p, p+n) 을 nchunks 개 구간으로 나눠 스레드마다 세고 합침.
+// 구간은 '\n' 바로 다음에서 시작하도록 맞춥니다. '\n' 뒤에서는 단어도 UTF-8
+// 시퀀스도 이어지지 않으므로 각 구간을 처음 상태로 세어 더하기만 하면 한 번에
+// 센 것과 같습니다. 줄이 구간보다 길면 그 구간은 다음 구간과 합쳐집니다.
+// 작은 파일은 구간이 MIN_CHUNK 보다 작아지지 않게 스레드 수를 줄입니다.
+void count_parallel(const unsigned char *p, size_t n, int nchunks, count_fn count,
+                    struct wc_counts *c, struct wc_extra *e) {
+    struct chunk chunks[MAX_JOBS];
+    int started[MAX_JOBS];
+    size_t start = 0;
+
+    if ((size_t)nchunks > n / MIN_CHUNK) nchunks = n / MIN_CHUNK;
+    if (nchunks < 1) nchunks = 1;
+
+    for (int i = 0; i < nchunks; i++) {
+        size_t end = n;
+        struct chunk *ch = &chunks[i];
+
+        if (i < nchunks - 1) {
+            size_t from = n / nchunks * (i + 1);
+            if (from < start) from = start;
+            const unsigned char *nl = memchr(p + from, '\n', n - from);
+            if (nl) end = nl - p + 1;
+        }
+        ch->p = p + start;
+        ch->n = end - start;
+        ch->st = (struct wc_state){1, 0, 0};   // 파일 시작, '\n' 다음은 모두 처음 상태
+        ch->count = count;
+        memset(&ch->c, 0, sizeof(ch->c));
+        ch->e = (i == 0 || !e) ? e : extra_new();   // 첫 구간은 e 에 바로 모음
+        // 첫 구간은 이 스레드가 직접 셈. 스레드를 못 만들면 그 구간도 직접 셈
+        started[i] = (i > 0 && ch->n > 0 &&
+                      pthread_create(&ch->tid, NULL, count_chunk_main, ch) == 0);
+        if (i > 0 && !started[i]) count_chunk_main(ch);
+        start = end;
+    }
+    count_chunk_main(&chunks[0]);
+    for (int i = 0; i < nchunks; i++) {
+        if (started[i]) pthread_join(chunks[i].tid, NULL);
+        c->lines += chunks[i].c.lines;
+        c->words += chunks[i].c.words;
+        c->chars += chunks[i].c.chars;
+        c->bytes += chunks[i].c.bytes;
+        if (i > 0 && e) {
+            extra_merge(e, chunks[i].e);
+            extra_free(chunks[i].e);
+        }
+    }
+}
+
+// 파일 전체를 한 번만 훑어서 줄/단어/바이트를 셈.
+// 일반 파일은 mmap 해서 커널에 그대로 넘기고, mmap 할 수 없으면(파이프, 터미널 등)
+// 큰 블록으로 끝까지 read. 어느 쪽도 lseek 하지 않습니다.
+int count_fd(int fd, const char *name, int nchunks, count_fn count, struct wc_counts *c,
+             struct wc_extra *e) {
+    struct stat st;
+    struct wc_state ws = {1, 0, 0};   // 파일 시작은 구분자 뒤로 취급
 
-    printf("Line count : %d\n", line_count);
-    printf("Word count : %d\n", word_count);
-    printf("File size : %ld \n", filesize);
+    if (fstat(fd, &st) < 0) {
+        perror(name);
+        return -1;
+    }
+    // 표준 입력은 현재 오프셋부터 읽어야 하므로 일반 파일이어도 mmap 하지 않음
+    if (S_ISREG(st.st_mode) && st.st_size > 0 && fd != STDIN_FILENO) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            count_parallel(map, st.st_size, nchunks, count, c, e);
+            munmap(map, st.st_size);
+            return 0;
+        }
+    }
 
-    fclose(fp);
+    unsigned char *buf = malloc(BUFFSIZE);
+    ssize_t n;
+    if (!buf) {
+        perror("malloc");
+        return -1;
+    }
+    while ((n = read(fd, buf, BUFFSIZE)) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            perror(name);
+            free(buf);
+            return -1;
+        }
+        count_block(count, buf, n, &ws, c, e);
+    }
+    if (e) extra_finish(e);
+    free(buf);
     return 0;
 }
+
+// "-" 는 표준 입력. 결과는 f 에 두고 완료를 main 에 알림
+int count_file(struct wc_pool *pool, struct wc_file *f) {
+    int fd = STDIN_FILENO;
+    int ret;
+
+    if (strcmp(f->name, "-") != 0) {
+        fd = open(f->name, O_RDONLY);
+        if (fd < 0) perror(f->name);
+    }
+    if (extra_on) f->e = extra_new();
+    ret = (fd < 0) ? -1 : count_fd(fd, f->name, pool->nchunks, pool->count, &f->c, f->e);
+    if (fd > STDIN_FILENO) close(fd);
+
+    pthread_mutex_lock(&pool->lock);
+    f->state = (ret < 0) ? -1 : 1;
+    pthread_cond_broadcast(&pool->done);
+    pthread_mutex_unlock(&pool->lock);
+    return ret;
+}
+
+void *pool_worker_main(void *arg) {
+    struct wc_pool *pool = arg;
+
+    for (;;) {
+        pthread_mutex_lock(&pool->lock);
+        int i = pool->next < pool->nfiles ? pool->next++ : -1;
+        pthread_mutex_unlock(&pool->lock);
+        if (i < 0) break;
+        count_file(pool, &pool->files[i]);
+    }
+    return NULL;
+}
+
+void print_counts(const struct wc_counts *c, const struct wc_extra *e, const char *name) {
+    printf("%8llu %8llu ", c->lines, c->words);
+    if (chars_opt) printf("%8llu ", c->chars);
+    printf("%8llu ", c->bytes);
+    if (longest_opt) printf("%8llu ", e->max_line);
+    printf("%s\n", name);
+}
+
+static int cmp_word_entry(const void *a, const void *b) {
+    const struct word_entry *x = *(const struct word_entry *const *)a;
+    const struct word_entry *y = *(const struct word_entry *const *)b;
+    int r;
+
+    if (x->count != y->count) return (x->count < y->count) ? 1 : -1;
+    r = memcmp(x->key, y->key, (x->len < y->len) ? x->len : y->len);
+    return r ? r : (int)x->len - (int)y->len;
+}
+
+// -H 는 0 이 아닌 바이트 값만, -t 는 빈도 내림차순(같으면 바이트 순)으로 출력
+void print_extra(struct wc_extra *e) {
+    if (hist_opt) {
+        printf("Byte histogram :\n");
+        for (int b = 0; b < 256; b++) {
+            unsigned long long n = e->hist[0][b] + e->hist[1][b] + e->hist[2][b] + e->hist[3][b];
+            if (n) printf("  0x%02x %12llu\n", b, n);
+        }
+    }
+    if (top_opt) {
+        struct word_entry **v = malloc((e->words.used + 1) * sizeof(*v));
+        size_t n = 0;
+        if (!v) {
+            perror("malloc");
+            exit(1);
+        }
+        for (size_t i = 0; i < e->words.cap; i++)
+            if (e->words.slots[i].key) v[n++] = &e->words.slots[i];
+        qsort(v, n, sizeof(*v), cmp_word_entry);
+        printf("Top %d words :\n", top_opt);
+        for (size_t i = 0; i < n && i < (size_t)top_opt; i++)
+            printf("  %12llu %.*s\n", v[i]->count, (int)v[i]->len, v[i]->key);
+        free(v);
+    }
+}
+
+void print_usage(const char *prog) {
+    fprintf(stderr, "Usage: %s [-mLH] [-t N] [-j N] [file ...]\n", prog);
+    fprintf(stderr, "  -m    UTF-8 문자 수도 출력\n");
+    fprintf(stderr, "  -L    가장 긴 줄의 길이(바이트)도 출력\n");
+    fprintf(stderr, "  -H    바이트 값 히스토그램 출력\n");
+    fprintf(stderr, "  -t N  가장 많이 나온 단어 N 개 출력\n");
+    fprintf(stderr, "  file 이 없거나 - 이면 표준 입력을 셉니다\n");
+}
+
+int main(int argc, char *argv[]) {
+    struct wc_counts total = {0, 0, 0, 0};
+    struct wc_extra *total_extra = NULL;
+    struct wc_pool pool;
+    pthread_t tids[MAX_JOBS];
+    int nworkers = 0, opt, ret = 0;
+
+    while ((opt = getopt(argc, argv, "mLHt:j:")) != -1) {
+        switch (opt) {
+            case 'm':
+                chars_opt = 1;
+                break;
+            case 'L':
+                longest_opt = 1;
+                break;
+            case 'H':
+                hist_opt = 1;
+                break;
+            case 't': {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n < 1 || n > MAX_TOP) {
+                    fprintf(stderr, "-t: word count must be 1..%d\n", MAX_TOP);
+                    print_usage(argv[0]);
+                    return 2;
+                }
+                top_opt = (int)n;
+                break;
+            }
+            case 'j': {
+                char *end;
+                long n = strtol(optarg, &end, 10);
+                if (*optarg == '\0' || *end != '\0' || n < 1 || n > MAX_JOBS) {
+                    fprintf(stderr, "-j: thread count must be 1..%d\n", MAX_JOBS);
+                    print_usage(argv[0]);
+                    return 2;
+                }
+                jobs_opt = (int)n;
+                break;
+            }
+            default:
+                print_usage(argv[0]);
+                return 2;
+        }
+    }
+
+    extra_on = longest_opt || hist_opt || top_opt;
+    if (extra_on) total_extra = extra_new();
+
+    static char *stdin_only[] = {"-"};
+    char **names = (optind < argc) ? argv + optind : stdin_only;
+    int nfiles = (optind < argc) ? argc - optind : 1;
+
+    pool.files = calloc(nfiles, sizeof(*pool.files));
+    if (!pool.files) {
+        perror("calloc");
+        return 1;
+    }
+    for (int i = 0; i < nfiles; i++) pool.files[i].name = names[i];
+    pool.nfiles = nfiles;
+    pool.next = 0;
+    pool.nchunks = (nfiles == 1) ? jobs_opt : 1;
+    pool.count = select_kernel();   // SIMD 커널은 실행 시점에 선택
+    pthread_mutex_init(&pool.lock, NULL);
+    pthread_cond_init(&pool.done, NULL);
+
+    // 입력이 여럿이면 min(N, 입력 수) 개 작업자가 입력 단위로 나눠 가짐.
+    // 스레드를 하나도 못 만들었거나 입력이 하나면 main 이 직접 셈
+    if (nfiles > 1) {
+        int want = (jobs_opt < nfiles) ? jobs_opt : nfiles;
+        while (nworkers < want &&
+               pthread_create(&tids[nworkers], NULL, pool_worker_main, &pool) == 0)
+            nworkers++;
+    }
+    if (nworkers == 0) pool_worker_main(&pool);
+
+    // 인자 순서대로, 앞 입력이 끝나는 대로 출력
+    for (int i = 0; i < nfiles; i++) {
+        struct wc_file *f = &pool.files[i];
+
+        pthread_mutex_lock(&pool.lock);
+        while (f->state == 0) pthread_cond_wait(&pool.done, &pool.lock);
+        pthread_mutex_unlock(&pool.lock);
+        if (f->state < 0) {
+            extra_free(f->e);
+            ret = 1;
+            continue;
+        }
+        if (nfiles == 1) {
+            printf("Line count : %llu\n", f->c.lines);
+            printf("Word count : %llu\n", f->c.words);
+            if (chars_opt) printf("Char count : %llu\n", f->c.chars);
+            printf("File size : %llu \n", f->c.bytes);
+            if (longest_opt) printf("Longest line : %llu\n", f->e->max_line);
+        } else {
+            print_counts(&f->c, f->e, f->name);
+            fflush(stdout);
+        }
+        // 히스토그램과 단어 빈도는 모든 입력을 합쳐 마지막에 한 번 출력
+        if (f->e) {
+            extra_merge(total_extra, f->e);
+            extra_free(f->e);
+        }
+        total.lines += f->c.lines;
+        total.words += f->c.words;
+        total.chars += f->c.chars;
+        total.bytes += f->c.bytes;
+    }
+    if (nfiles > 1) print_counts(&total, total_extra, "total");
+    if (total_extra) {
+        print_extra(total_extra);
+        extra_free(total_extra);
+    }
+
+    for (int i = 0; i < nworkers; i++) pthread_join(tids[i], NULL);
+    pthread_mutex_destroy(&pool.lock);
+    pthread_cond_destroy(&pool.done);
+    free(pool.files);
+    return ret;
+}
@@ -0,0 +1,41 @@
+#!/usr/bin/env bash
+set -euo pipefail
+
+SCRIPT_DIR=$(cd "$(dirname "${BASH_SOURCE[0]}")" && pwd)
+PROG="$SCRIPT_DIR/../mini_wc"
+TEST_DIR=$(mktemp -d)
+cd "$TEST_DIR"
+
+echo "Running mini_wc smoke tests in $TEST_DIR"
+
+# Test 1: 유니코드 공백 중 U+00A0, U+1680, U+2000, U+2007, U+202F, U+205F, U+3000 은
+# 단어를 나누고 U+0085, U+2028, U+2029, U+200B 는 나누지 않음 (GNU wc 9.1 과 같음)
+printf 'a\xc2\xa0b a\xe1\x9a\x80b a\xe2\x80\x80b a\xe2\x80\x87b a\xe2\x80\xafb a\xe2\x81\x9fb a\xe3\x80\x80b\n' > split.txt
+printf 'a\xc2\x85b a\xe2\x80\xa8b a\xe2\x80\xa9b a\xe2\x80\x8bb\n' > nosplit.txt
+for j in 1 4; do
+    if "$PROG" -j "$j" split.txt | grep -q "^Word count : 14$" &&
+        "$PROG" -j "$j" nosplit.txt | grep -q "^Word count : 4$"; then
+        echo "[PASS] Unicode whitespace word splitting (-j $j)"
+    else
+        echo "[FAIL] Unicode whitespace word splitting (-j $j)"
+        "$PROG" -j "$j" split.txt nosplit.txt
+        exit 1
+    fi
+done
+
+# Test 2: 같은 글자가 SIMD 블록(64 바이트) 경계를 넘어도 같은 결과
+head -c 61 /dev/zero | tr '\0' x > long.txt
+cat split.txt nosplit.txt >> long.txt
+if "$PROG" -m long.txt | grep -q "^Word count : 18$"; then
+    echo "[PASS] multi-byte space across block boundary"
+else
+    echo "[FAIL] multi-byte space across block boundary"
+    "$PROG" -m long.txt
+    exit 1
+fi
+
+# Cleanup
+cd - > /dev/null
+rm -rf "$TEST_DIR"
+
+echo "All tests completed"